@@ -19,6 +19,7 @@
 #include "benchmark.h"
 #include "numa.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
@@ -512,4 +513,87 @@ BenchmarkSetup setup_benchmark(std::istream& is) {
     return setup;
 }
 
+// Builds the searches of the thread scaling test, which compares the time to reach
+// a fixed depth and the nodes per second of Lazy SMP and of the root move split
+// scheduler, see the RootSplit option. There are three parameters: the largest
+// number of threads, the depth and the TT size in MB. The thread counts double
+// from 1 up to the largest one. The default positions up to the endgames are used.
+ScalingSetup setup_scaling(std::istream& is) {
+
+    static constexpr int    DEFAULT_DEPTH   = 16;
+    static constexpr int    DEFAULT_TT_SIZE = 256;
+    static constexpr size_t POSITIONS       = 16;
+
+    ScalingSetup setup{};
+    int          maxThreads;
+
+    if (!(is >> maxThreads))
+        maxThreads = int(get_hardware_concurrency());
+
+    if (!(is >> setup.depth))
+        setup.depth = DEFAULT_DEPTH;
+
+    if (!(is >> setup.ttSize))
+        setup.ttSize = DEFAULT_TT_SIZE;
+
+    setup.filledInvocation += std::to_string(maxThreads) + " " + std::to_string(setup.depth)
+                            + " " + std::to_string(setup.ttSize);
+
+    for (int threads = 1; threads < maxThreads; threads *= 2)
+        setup.threads.push_back(threads);
+
+    setup.threads.push_back(std::max(maxThreads, 1));
+
+    for (const std::string& fen : Defaults)
+        if (fen.find("setoption") == std::string::npos)
+        {
+            setup.commands.emplace_back("position fen " + fen);
+            setup.commands.emplace_back("go depth " + std::to_string(setup.depth));
+
+            if (setup.commands.size() == 2 * POSITIONS)
+                break;
+        }
+
+    return setup;
+}
+
+EvalSpeedSetup setup_eval_speed(std::istream& is, int defaultRounds) {
+
+    EvalSpeedSetup setup{};
+
+    if (!(is >> setup.rounds) || setup.rounds < 1)
+        setup.rounds = defaultRounds;
+
+    setup.filledInvocation += std::to_string(setup.rounds);
+
+    // The standard chess positions, without the moves played from them
+    for (const std::string& fen : Defaults)
+    {
+        if (fen == "setoption name UCI_Chess960 value true")
+            break;
+
+        if (fen.find("setoption") == std::string::npos)
+            setup.fens.emplace_back(fen.substr(0, fen.find(" moves ")));
+    }
+
+    return setup;
+}
+
+// The accumulator benchmark replays the recorded games of the speedtest positions
+// `rounds` times.
+AccumulatorBenchSetup setup_accumulator_bench(std::istream& is) {
+
+    static constexpr int DEFAULT_ROUNDS = 3;
+
+    AccumulatorBenchSetup setup{};
+
+    if (!(is >> setup.rounds) || setup.rounds < 1)
+        setup.rounds = DEFAULT_ROUNDS;
+
+    setup.filledInvocation += std::to_string(setup.rounds);
+    setup.games = BenchmarkPositions;
+
+    return setup;
+}
+
 }  // namespace Stockfish
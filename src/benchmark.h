@@ -37,6 +37,32 @@ struct BenchmarkSetup {
 
 BenchmarkSetup setup_benchmark(std::istream&);
 
+struct ScalingSetup {
+    int                      ttSize;
+    int                      depth;
+    std::vector<int>         threads;   // The thread counts to compare, in increasing order
+    std::vector<std::string> commands;  // Run once for each thread count and scheduler mode
+    std::string              filledInvocation;
+};
+
+ScalingSetup setup_scaling(std::istream&);
+
+struct EvalSpeedSetup {
+    int                      rounds;
+    std::vector<std::string> fens;
+    std::string              filledInvocation;
+};
+
+EvalSpeedSetup setup_eval_speed(std::istream&, int defaultRounds = 1000);
+
+struct AccumulatorBenchSetup {
+    int                                   rounds;
+    std::vector<std::vector<std::string>> games;  // Positions with the same side to move
+    std::string                           filledInvocation;
+};
+
+AccumulatorBenchSetup setup_accumulator_bench(std::istream&);
+
 }  // namespace Stockfish
 
 #endif  // #ifndef BENCHMARK_H_INCLUDED
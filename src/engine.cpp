@@ -31,6 +31,7 @@
 
 #include "evaluate.h"
 #include "misc.h"
+#include "movegen.h"
 #include "nnue/network.h"
 #include "nnue/nnue_common.h"
 #include "nnue/nnue_misc.h"
@@ -87,12 +88,24 @@ Engine::Engine(std::optional<std::string> path) :
           return thread_allocation_information_as_string();
       }));
 
+    options.add("RootSplit", Option(false));
+
     options.add(  //
       "Hash", Option(16, 1, MaxHashMB, [this](const Option& o) {
           set_tt_size(o);
           return std::nullopt;
       }));
 
+    options.add(  //
+      "SharedHash", Option("", [this](const Option& o) -> std::optional<std::string> {
+          set_tt_size(options["Hash"]);
+          if (!tt.is_shared() && !std::string(o).empty())
+              return "Failed to attach the shared hash, using a private one instead.";
+          return std::nullopt;
+      }));
+
+    options.add("WarmFinnyTables", Option(false));
+
     options.add(  //
       "Clear Hash", Option([this](const Option&) {
           search_clear();
@@ -121,9 +134,19 @@ Engine::Engine(std::optional<std::string> path) :
 
     options.add("UCI_ShowWDL", Option(false));
 
+    options.add("InfoFormat", Option("text var text var json", "text"));
+
+    options.add(  //
+      "SyzygyPath", Option("", [this](const Option& o) {
+          Tablebases::init(o, options["SyzygyIndexFile"]);
+          Tablebases::premap(options);
+          return std::nullopt;
+      }));
+
     options.add(  //
-      "SyzygyPath", Option("", [](const Option& o) {
-          Tablebases::init(o);
+      "SyzygyIndexFile", Option("", [this](const Option& o) {
+          Tablebases::init(options["SyzygyPath"], o);
+          Tablebases::premap(options);
           return std::nullopt;
       }));
 
@@ -133,6 +156,21 @@ Engine::Engine(std::optional<std::string> path) :
 
     options.add("SyzygyProbeLimit", Option(7, 0, 7));
 
+    options.add(  //
+      "SyzygyPremap", Option("none var none var all var root", "none", [this](const Option&) {
+          Tablebases::premap(options);
+          return std::nullopt;
+      }));
+
+    options.add("SyzygyWillNeed", Option(false));
+
+    options.add(  //
+      "SyzygyProbeCache", Option(0, 0, 1024, [this](const Option& o) {
+          wait_for_search_finished();
+          Tablebases::set_probe_cache_size(size_t(o));
+          return std::nullopt;
+      }));
+
     options.add(  //
       "EvalFile", Option(EvalFileDefaultNameBig, [this](const Option& o) {
           load_big_network(o);
@@ -159,18 +197,29 @@ void Engine::go(Search::LimitsType& limits) {
     assert(limits.perft == 0);
     verify_networks();
 
+    Tablebases::premap(options, &pos);
     threads.start_thinking(options, pos, states, limits);
 }
 void Engine::stop() { threads.stop = true; }
 
+void Engine::batch(const std::function<bool(std::string&)>& next,
+                   const Search::LimitsType&                 limits,
+                   const Search::UpdateBatch&                onResult) {
+    wait_for_search_finished();
+    verify_networks();
+
+    threads.analyse(next, limits, onResult);
+}
+
 void Engine::search_clear() {
     wait_for_search_finished();
 
     tt.clear(threads);
-    threads.clear();
+    threads.clear(options["WarmFinnyTables"]);
 
     // @TODO wont work with multiple instances
-    Tablebases::init(options["SyzygyPath"]);  // Free mapped files
+    Tablebases::init(options["SyzygyPath"], options["SyzygyIndexFile"]);  // Free mapped files
+    Tablebases::premap(options);
 }
 
 void Engine::set_on_update_no_moves(std::function<void(const Engine::InfoShort&)>&& f) {
@@ -189,6 +238,10 @@ void Engine::set_on_bestmove(std::function<void(std::string_view, std::string_vi
     updateContext.onBestmove = std::move(f);
 }
 
+void Engine::set_on_root_probe(std::function<void(const Engine::InfoRootProbe&)>&& f) {
+    updateContext.onRootProbe = std::move(f);
+}
+
 void Engine::set_on_verify_networks(std::function<void(std::string_view)>&& f) {
     onVerifyNetworks = std::move(f);
 }
@@ -250,7 +303,17 @@ void Engine::resize_threads() {
 
 void Engine::set_tt_size(size_t mb) {
     wait_for_search_finished();
-    tt.resize(mb, threads);
+    tt.resize(mb, threads, options["SharedHash"]);
+}
+
+bool Engine::save_tt(const std::string& file) {
+    wait_for_search_finished();
+    return tt.save(file);
+}
+
+bool Engine::load_tt(const std::string& file) {
+    wait_for_search_finished();
+    return tt.load(file, threads);
 }
 
 void Engine::set_ponderhit(bool b) { threads.main_manager()->ponder = b; }
@@ -315,9 +378,10 @@ void Engine::load_small_network(const std::string& file) {
     threads.ensure_network_replicated();
 }
 
-void Engine::save_network(const std::pair<std::optional<std::string>, std::string> files[2]) {
-    networks.modify_and_replicate([&files](NN::Networks& networks_) {
-        networks_.big.save(files[0].first);
+void Engine::save_network(const std::pair<std::optional<std::string>, std::string> files[2],
+                          bool compressedThreats) {
+    networks.modify_and_replicate([&files, compressedThreats](NN::Networks& networks_) {
+        networks_.big.save(files[0].first, compressedThreats);
         networks_.small.save(files[1].first);
     });
 }
@@ -334,6 +398,206 @@ void Engine::trace_eval() const {
     sync_cout << "\n" << Eval::trace(p, *networks) << sync_endl;
 }
 
+std::pair<std::vector<Value>, TimePoint>
+Engine::evaluate_positions(const std::vector<std::string>& fens, int rounds, bool batched) const {
+    std::deque<StateInfo>        evalStates(fens.size());
+    std::deque<Position>         positions(fens.size());
+    std::vector<const Position*> evaluated;
+
+    for (size_t i = 0; i < fens.size(); ++i)
+    {
+        positions[i].set(fens[i], false, &evalStates[i]);
+
+        if (!positions[i].checkers())
+            evaluated.push_back(&positions[i]);
+    }
+
+    verify_networks();
+
+    auto accumulators = std::make_unique<Eval::NNUE::AccumulatorStack>();
+    auto caches       = std::make_unique<Eval::NNUE::AccumulatorCaches>(*networks);
+
+    std::vector<Value> values(evaluated.size());
+    TimePoint          elapsed = now();
+
+    for (int r = 0; r < rounds; ++r)
+        if (batched)
+            Eval::evaluate_batch(*networks, evaluated.data(), evaluated.size(), *accumulators,
+                                 *caches, values.data());
+        else
+            for (size_t i = 0; i < evaluated.size(); ++i)
+            {
+                // The positions are unrelated, as within a batch
+                accumulators->reset();
+                values[i] =
+                  Eval::evaluate(*networks, *evaluated[i], *accumulators, *caches, VALUE_ZERO);
+            }
+
+    return {values, now() - elapsed};
+}
+
+uint64_t
+Engine::time_propagation(const std::vector<std::string>& fens, int rounds, bool batched) const {
+    std::deque<StateInfo>        timeStates(fens.size());
+    std::deque<Position>         positions(fens.size());
+    std::vector<const Position*> pointers;
+
+    for (size_t i = 0; i < fens.size(); ++i)
+    {
+        positions[i].set(fens[i], false, &timeStates[i]);
+        pointers.push_back(&positions[i]);
+    }
+
+    verify_networks();
+
+    auto accumulators = std::make_unique<NN::AccumulatorStack>();
+    auto caches       = std::make_unique<NN::AccumulatorCaches>(*networks);
+
+    return networks->big.time_propagation(pointers.data(), pointers.size(), *accumulators,
+                                          caches->big, rounds, batched)
+         + networks->small.time_propagation(pointers.data(), pointers.size(), *accumulators,
+                                            caches->small, rounds, batched);
+}
+
+std::vector<NN::KernelTiming> Engine::tune_kernels(const std::vector<std::string>& fens,
+                                                   int                             rounds) {
+    constexpr int Trials = 5;
+
+    wait_for_search_finished();
+    verify_networks();
+
+    std::deque<StateInfo>        tuneStates(fens.size());
+    std::deque<Position>         positions(fens.size());
+    std::vector<const Position*> pointers;
+
+    for (size_t i = 0; i < fens.size(); ++i)
+    {
+        positions[i].set(fens[i], false, &tuneStates[i]);
+        pointers.push_back(&positions[i]);
+    }
+
+    auto accumulators = std::make_unique<NN::AccumulatorStack>();
+    auto caches       = std::make_unique<NN::AccumulatorCaches>(*networks);
+
+    std::vector<NN::KernelTiming> timings;
+
+    for (int sparse = 0; sparse <= int(NN::SparseKernel::BitScan); ++sparse)
+        for (int dense = 0; dense <= int(NN::DenseKernel::HalfOutputs); ++dense)
+            timings.push_back({{NN::SparseKernel(sparse), NN::DenseKernel(dense)}, UINT64_MAX});
+
+    auto select = [](const NN::LayerKernels& kernels) {
+        NN::BigNetworkArchitecture::select_kernels(kernels);
+        NN::SmallNetworkArchitecture::select_kernels(kernels);
+    };
+
+    // Alternate the kernels and keep the best time of each, to be less sensitive to noise
+    for (int trial = 0; trial < Trials; ++trial)
+        for (auto& t : timings)
+        {
+            select(t.kernels);
+
+            const uint64_t ns =
+              networks->big.time_propagation(pointers.data(), pointers.size(), *accumulators,
+                                             caches->big, rounds)
+              + networks->small.time_propagation(pointers.data(), pointers.size(), *accumulators,
+                                                 caches->small, rounds);
+
+            t.nanoseconds = std::min(t.nanoseconds, ns);
+        }
+
+    select(std::min_element(timings.begin(), timings.end(), [](const auto& a, const auto& b) {
+               return a.nanoseconds < b.nanoseconds;
+           })->kernels);
+
+    return timings;
+}
+
+std::array<NN::AccumulatorTimings, 2>
+Engine::time_accumulator_updates(const std::vector<std::vector<std::string>>& games, int rounds) {
+
+    struct Line {
+        std::string       fen;
+        std::vector<Move> moves;
+    };
+
+    // Finds the two moves leading from one recorded position to the next
+    auto moves_between = [](const std::string& from, const std::string& to) {
+        StateInfo st, st1, st2, targetSt;
+        Position  current, target;
+
+        current.set(from, false, &st);
+        target.set(to, false, &targetSt);
+
+        for (const auto& m1 : MoveList<LEGAL>(current))
+        {
+            current.do_move(m1, st1);
+
+            for (const auto& m2 : MoveList<LEGAL>(current))
+            {
+                current.do_move(m2, st2);
+                const bool found = current.key() == target.key();
+                current.undo_move(m2);
+
+                if (found)
+                    return std::vector<Move>{m1, m2};
+            }
+
+            current.undo_move(m1);
+        }
+
+        return std::vector<Move>{};
+    };
+
+    wait_for_search_finished();
+    verify_networks();
+
+    // A line is cut where the recorded positions are not two moves apart
+    std::vector<Line> lines;
+
+    for (const auto& game : games)
+        for (size_t i = 0; i < game.size(); ++i)
+        {
+            auto moves = i ? moves_between(game[i - 1], game[i]) : std::vector<Move>{};
+
+            if (moves.empty() || lines.back().moves.size() + 2 >= NN::AccumulatorStack::MaxSize)
+                lines.push_back({game[i], {}});
+            else
+                lines.back().moves.insert(lines.back().moves.end(), moves.begin(), moves.end());
+        }
+
+    auto accumulators = std::make_unique<NN::AccumulatorStack>();
+    auto caches       = std::make_unique<NN::AccumulatorCaches>(*networks);
+
+    std::array<NN::AccumulatorTimings, 2> timings{};
+
+    for (int r = 0; r < rounds; ++r)
+        for (const auto& line : lines)
+        {
+            std::deque<StateInfo> replayStates(1);
+            Position              replay;
+
+            replay.set(line.fen, false, &replayStates.back());
+
+            accumulators->reset();
+            networks->big.evaluate(replay, *accumulators, caches->big);
+            networks->small.evaluate(replay, *accumulators, caches->small);
+
+            for (Move m : line.moves)
+            {
+                auto [dirtyPiece, dirtyThreats] = accumulators->push();
+                replay.do_move(m, replayStates.emplace_back(), replay.gives_check(m), dirtyPiece,
+                               dirtyThreats, nullptr, nullptr);
+
+                networks->big.time_accumulator_updates(replay, *accumulators, caches->big,
+                                                       timings[0]);
+                networks->small.time_accumulator_updates(replay, *accumulators, caches->small,
+                                                         timings[1]);
+            }
+        }
+
+    return timings;
+}
+
 const OptionsMap& Engine::get_options() const { return options; }
 OptionsMap&       Engine::get_options() { return options; }
 
@@ -349,6 +613,47 @@ std::string Engine::visualize() const {
 
 int Engine::get_hashfull(int maxAge) const { return tt.hashfull(maxAge); }
 
+size_t Engine::get_threat_weight_rows() const { return networks->big.threat_weight_rows(); }
+
+bool Engine::shares_threat_rows() const { return networks->big.shares_threat_rows(); }
+
+void Engine::share_threat_rows(bool share) {
+    networks.modify_and_replicate(
+      [share](NN::Networks& networks_) { networks_.big.share_threat_rows(share); });
+    threads.ensure_network_replicated();
+}
+
+uint64_t Engine::get_tt_rejected_probes() const { return tt.rejected_probes(); }
+
+uint64_t Engine::get_tb_mapping_wait() const { return Tablebases::mapping_wait_time(); }
+
+TTStats Engine::get_tt_stats() {
+    wait_for_search_finished();
+    return threads.tt_stats();
+}
+
+Eval::NNUE::AccumulatorStats Engine::get_accumulator_stats() {
+    wait_for_search_finished();
+    return threads.accumulator_stats();
+}
+
+Eval::NNUE::EvalProfile Engine::get_nnue_profile() {
+    wait_for_search_finished();
+    return threads.nnue_profile();
+}
+
+Tablebases::ProbeCacheStats Engine::get_tb_cache_stats() {
+    wait_for_search_finished();
+    return threads.tb_cache_stats();
+}
+
+Tablebases::PremapStats Engine::get_tb_premap_stats() const { return Tablebases::premap_stats(); }
+
+TTOccupancy Engine::get_tt_occupancy() {
+    wait_for_search_finished();
+    return tt.occupancy(threads);
+}
+
 std::vector<std::pair<size_t, size_t>> Engine::get_bound_thread_count_by_numa_node() const {
     auto                                   counts = threads.get_bound_thread_count_by_numa_node();
     const NumaConfig&                      cfg    = numaContext.get_numa_config();
@@ -403,6 +708,12 @@ std::string Engine::thread_allocation_information_as_string() const {
     ss << " with NUMA node thread binding: ";
     ss << boundThreadsByNodeStr;
 
+    // Locality of the TT probes of the last search, with TT_STATS
+    const uint64_t localProbes  = threads.tt_local_probes();
+    const uint64_t remoteProbes = threads.tt_remote_probes();
+    if (localProbes + remoteProbes)
+        ss << ", TT probes local/remote: " << localProbes << "/" << remoteProbes;
+
     return ss.str();
 }
 }
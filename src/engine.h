@@ -19,6 +19,7 @@
 #ifndef ENGINE_H_INCLUDED
 #define ENGINE_H_INCLUDED
 
+#include <array>
 #include <cstddef>
 #include <cstdint>
 #include <functional>
@@ -43,9 +44,10 @@ namespace Stockfish {
 
 class Engine {
    public:
-    using InfoShort = Search::InfoShort;
-    using InfoFull  = Search::InfoFull;
-    using InfoIter  = Search::InfoIteration;
+    using InfoShort     = Search::InfoShort;
+    using InfoFull      = Search::InfoFull;
+    using InfoIter      = Search::InfoIteration;
+    using InfoRootProbe = Search::InfoRootProbe;
 
     Engine(std::optional<std::string> path = std::nullopt);
 
@@ -63,6 +65,10 @@ class Engine {
     void go(Search::LimitsType&);
     // non blocking call to stop searching
     void stop();
+    // blocking call to search the positions returned by `next` in parallel
+    void batch(const std::function<bool(std::string&)>& next,
+               const Search::LimitsType&                 limits,
+               const Search::UpdateBatch&                onResult);
 
     // blocking call to wait for search to finish
     void wait_for_search_finished();
@@ -74,6 +80,8 @@ class Engine {
     void set_numa_config_from_option(const std::string& o);
     void resize_threads();
     void set_tt_size(size_t mb);
+    bool save_tt(const std::string& file);
+    bool load_tt(const std::string& file);
     void set_ponderhit(bool);
     void search_clear();
 
@@ -81,6 +89,7 @@ class Engine {
     void set_on_update_full(std::function<void(const InfoFull&)>&&);
     void set_on_iter(std::function<void(const InfoIter&)>&&);
     void set_on_bestmove(std::function<void(std::string_view, std::string_view)>&&);
+    void set_on_root_probe(std::function<void(const InfoRootProbe&)>&&);
     void set_on_verify_networks(std::function<void(std::string_view)>&&);
 
     // network related
@@ -89,16 +98,43 @@ class Engine {
     void load_networks();
     void load_big_network(const std::string& file);
     void load_small_network(const std::string& file);
-    void save_network(const std::pair<std::optional<std::string>, std::string> files[2]);
+    void save_network(const std::pair<std::optional<std::string>, std::string> files[2],
+                      bool compressedThreats = false);
 
     // utility functions
 
     void trace_eval() const;
+    // statically evaluate the positions `rounds` times, one by one or in batches,
+    // returning the evaluations and the time spent. Positions in check are skipped.
+    std::pair<std::vector<Value>, TimePoint>
+    evaluate_positions(const std::vector<std::string>& fens, int rounds, bool batched) const;
+    // time the propagation of the positions through the layers of both networks `rounds`
+    // times, one by one or in batches, in nanoseconds
+    uint64_t time_propagation(const std::vector<std::string>& fens, int rounds, bool batched) const;
+    // time the interchangeable NNUE layer kernels on the positions and select the fastest
+    std::vector<Eval::NNUE::KernelTiming> tune_kernels(const std::vector<std::string>& fens,
+                                                       int                             rounds);
+    // time each kind of accumulator update, for the big and the small network, over the
+    // moves of recorded games given by their positions with the same side to move
+    std::array<Eval::NNUE::AccumulatorTimings, 2>
+    time_accumulator_updates(const std::vector<std::vector<std::string>>& games, int rounds);
 
     const OptionsMap& get_options() const;
     OptionsMap&       get_options();
 
-    int get_hashfull(int maxAge = 0) const;
+    int         get_hashfull(int maxAge = 0) const;
+    size_t      get_threat_weight_rows() const;
+    bool        shares_threat_rows() const;
+    void        share_threat_rows(bool share);
+    uint64_t    get_tt_rejected_probes() const;
+    uint64_t    get_tb_mapping_wait() const;
+    TTStats     get_tt_stats();
+    TTOccupancy get_tt_occupancy();
+
+    Eval::NNUE::AccumulatorStats get_accumulator_stats();
+    Eval::NNUE::EvalProfile      get_nnue_profile();
+    Tablebases::ProbeCacheStats  get_tb_cache_stats();
+    Tablebases::PremapStats      get_tb_premap_stats() const;
 
     std::string                            fen() const;
     void                                   flip();
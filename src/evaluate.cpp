@@ -27,6 +27,7 @@
 #include <memory>
 #include <sstream>
 #include <tuple>
+#include <vector>
 
 #include "nnue/network.h"
 #include "nnue/nnue_misc.h"
@@ -48,6 +49,32 @@ int Eval::simple_eval(const Position& pos) {
 
 bool Eval::use_smallnet(const Position& pos) { return std::abs(simple_eval(pos)) > 962; }
 
+namespace {
+
+// Turns the output of the net into the final evaluation
+Value blend(const Position& pos, Value psqt, Value positional, int optimism) {
+
+    Value nnue = (125 * psqt + 131 * positional) / 128;
+
+    // Blend optimism and eval with nnue complexity
+    int nnueComplexity = std::abs(psqt - positional);
+    optimism += optimism * nnueComplexity / 476;
+    nnue -= nnue * nnueComplexity / 18236;
+
+    int material = 534 * pos.count<PAWN>() + pos.non_pawn_material();
+    int v        = (nnue * (77871 + material) + optimism * (7191 + material)) / 77871;
+
+    // Damp down the evaluation linearly when shuffling
+    v -= v * pos.rule50_count() / 199;
+
+    // Guarantee evaluation does not hit the tablebase range
+    v = std::clamp(v, VALUE_TB_LOSS_IN_MAX_PLY + 1, VALUE_TB_WIN_IN_MAX_PLY - 1);
+
+    return v;
+}
+
+}  // namespace
+
 // Evaluate is the evaluator for the outer world. It returns a static evaluation
 // of the position from the point of view of the side to move.
 Value Eval::evaluate(const Eval::NNUE::Networks&    networks,
@@ -66,27 +93,60 @@ Value Eval::evaluate(const Eval::NNUE::Networks&    networks,
 
     // Re-evaluate the position when higher eval accuracy is worth the time spent
     if (smallNet && (std::abs(nnue) < 277))
-    {
         std::tie(psqt, positional) = networks.big.evaluate(pos, accumulators, caches.big);
-        nnue                       = (125 * psqt + 131 * positional) / 128;
-        smallNet                   = false;
-    }
 
-    // Blend optimism and eval with nnue complexity
-    int nnueComplexity = std::abs(psqt - positional);
-    optimism += optimism * nnueComplexity / 476;
-    nnue -= nnue * nnueComplexity / 18236;
+    return blend(pos, psqt, positional, optimism);
+}
 
-    int material = 534 * pos.count<PAWN>() + pos.non_pawn_material();
-    int v        = (nnue * (77871 + material) + optimism * (7191 + material)) / 77871;
+// Evaluates several unrelated positions without optimism, as evaluate() does but with
+// the positions of each net propagated together. The results are identical.
+void Eval::evaluate_batch(const Eval::NNUE::Networks&    networks,
+                          const Position* const*         positions,
+                          std::size_t                    count,
+                          Eval::NNUE::AccumulatorStack&  accumulators,
+                          Eval::NNUE::AccumulatorCaches& caches,
+                          Value*                         output) {
 
-    // Damp down the evaluation linearly when shuffling
-    v -= v * pos.rule50_count() / 199;
+    std::vector<const Position*>     smallPositions, bigPositions;
+    std::vector<std::size_t>         smallIndices, bigIndices;
+    std::vector<NNUE::NetworkOutput> smallOutputs, bigOutputs;
 
-    // Guarantee evaluation does not hit the tablebase range
-    v = std::clamp(v, VALUE_TB_LOSS_IN_MAX_PLY + 1, VALUE_TB_WIN_IN_MAX_PLY - 1);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        assert(!positions[i]->checkers());
 
-    return v;
+        bool smallNet = use_smallnet(*positions[i]);
+        (smallNet ? smallPositions : bigPositions).push_back(positions[i]);
+        (smallNet ? smallIndices : bigIndices).push_back(i);
+    }
+
+    smallOutputs.resize(smallPositions.size());
+    networks.small.evaluate_batch(smallPositions.data(), smallPositions.size(), accumulators,
+                                  caches.small, smallOutputs.data());
+
+    for (std::size_t i = 0; i < smallPositions.size(); ++i)
+    {
+        auto [psqt, positional] = smallOutputs[i];
+
+        // Same re-evaluation condition as in evaluate()
+        if (std::abs((125 * psqt + 131 * positional) / 128) < 277)
+        {
+            bigPositions.push_back(smallPositions[i]);
+            bigIndices.push_back(smallIndices[i]);
+        }
+        else
+            output[smallIndices[i]] = blend(*smallPositions[i], psqt, positional, 0);
+    }
+
+    bigOutputs.resize(bigPositions.size());
+    networks.big.evaluate_batch(bigPositions.data(), bigPositions.size(), accumulators,
+                                caches.big, bigOutputs.data());
+
+    for (std::size_t i = 0; i < bigPositions.size(); ++i)
+    {
+        auto [psqt, positional] = bigOutputs[i];
+        output[bigIndices[i]]   = blend(*bigPositions[i], psqt, positional, 0);
+    }
 }
 
 // Like evaluate(), but instead of returning a value, it returns
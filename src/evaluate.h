@@ -19,6 +19,7 @@
 #ifndef EVALUATE_H_INCLUDED
 #define EVALUATE_H_INCLUDED
 
+#include <cstddef>
 #include <string>
 
 #include "types.h"
@@ -51,6 +52,12 @@ Value evaluate(const NNUE::Networks&          networks,
                Eval::NNUE::AccumulatorStack&  accumulators,
                Eval::NNUE::AccumulatorCaches& caches,
                int                            optimism);
+void  evaluate_batch(const NNUE::Networks&          networks,
+                     const Position* const*         positions,
+                     std::size_t                    count,
+                     Eval::NNUE::AccumulatorStack&  accumulators,
+                     Eval::NNUE::AccumulatorCaches& caches,
+                     Value*                         output);
 }  // namespace Eval
 
 }  // namespace Stockfish
@@ -195,5 +195,61 @@ void aligned_large_pages_free(void* mem) {
 
 void aligned_large_pages_free(void* mem) { std_aligned_free(mem); }
 
+#endif
+
+
+// lazy_zeroed_alloc() maps fresh anonymous memory, aligned for transparent huge
+// pages. Memory allocated with lazy_zeroed_alloc() must be freed with
+// lazy_zeroed_free(), passing the same size.
+
+#if defined(__linux__) && !defined(__ANDROID__)
+
+static constexpr size_t LazyAlignment = 2 * 1024 * 1024;  // 2MB page size assumed
+
+static size_t lazy_size(size_t size) {
+    return (size + LazyAlignment - 1) / LazyAlignment * LazyAlignment;
+}
+
+void* lazy_zeroed_alloc(size_t allocSize) {
+
+    const size_t size = lazy_size(allocSize);
+
+    // Map an extra page, then trim the mapping down to an aligned one
+    void* mem =
+      mmap(nullptr, size + LazyAlignment, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED)
+        return nullptr;
+
+    char*        start   = static_cast<char*>(mem);
+    char*        aligned = reinterpret_cast<char*>(
+      (reinterpret_cast<uintptr_t>(start) + LazyAlignment - 1) & ~(LazyAlignment - 1));
+    const size_t head    = size_t(aligned - start);
+
+    if (head)
+        munmap(start, head);
+    munmap(aligned + size, LazyAlignment - head);
+
+    #if defined(MADV_HUGEPAGE)
+    madvise(aligned, size, MADV_HUGEPAGE);
+    #endif
+    return aligned;
+}
+
+void lazy_zeroed_free(void* mem, size_t size) {
+    if (mem)
+        munmap(mem, lazy_size(size));
+}
+
+// Drops the pages, private anonymous memory reads as zero when touched again
+bool lazy_zero(void* mem, size_t size) { return !madvise(mem, lazy_size(size), MADV_DONTNEED); }
+
+#else
+
+void* lazy_zeroed_alloc(size_t) { return nullptr; }
+
+void lazy_zeroed_free(void*, size_t) {}
+
+bool lazy_zero(void*, size_t) { return false; }
+
 #endif
 }  // namespace Stockfish
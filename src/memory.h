@@ -70,6 +70,13 @@ void  aligned_large_pages_free(void* mem);
 
 bool has_large_pages();
 
+// Zero-filled memory from pages which the OS only zeroes when first touched, so
+// that neither allocating nor re-zeroing costs time upfront. Only available on
+// Linux: elsewhere the allocation returns nullptr and re-zeroing returns false.
+void* lazy_zeroed_alloc(size_t size);
+void  lazy_zeroed_free(void* mem, size_t size);
+bool  lazy_zero(void* mem, size_t size);
+
 // Frees memory which was placed there with placement new.
 // Works for both single objects and arrays of unknown bound.
 template<typename T, typename FREE_FUNC>
@@ -269,6 +269,15 @@ std::string compiler_info() {
 #if !defined(NDEBUG)
     compiler += " DEBUG";
 #endif
+#if defined(TT_CHECK_ENTRIES)
+    compiler += " TT_CHECK_ENTRIES";
+#endif
+#if defined(TT_STATS)
+    compiler += " TT_STATS";
+#endif
+#if defined(NNUE_PROFILE)
+    compiler += " NNUE_PROFILE";
+#endif
 
     compiler += "\nCompiler __VERSION__ macro : ";
 #ifdef __VERSION__
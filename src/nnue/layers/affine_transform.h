@@ -193,6 +193,78 @@ class AffineTransform {
     // Forward propagation
     void propagate(const InputType* input, OutputType* output) const {
 
+#ifdef ENABLE_SEQ_OPT
+
+        if constexpr (OutputDimensions > 1)
+        {
+            kernel(*this, input, output);
+        }
+        else if constexpr (OutputDimensions == 1)
+        {
+    // We cannot use AVX512 for the last layer because there are only 32 inputs
+    // and the buffer is not padded to 64 elements.
+    #if defined(USE_AVX2)
+            using vec_t = __m256i;
+        #define vec_setzero() _mm256_setzero_si256()
+        #define vec_add_dpbusd_32 SIMD::m256_add_dpbusd_epi32
+        #define vec_hadd SIMD::m256_hadd
+    #elif defined(USE_SSSE3)
+            using vec_t = __m128i;
+        #define vec_setzero() _mm_setzero_si128()
+        #define vec_add_dpbusd_32 SIMD::m128_add_dpbusd_epi32
+        #define vec_hadd SIMD::m128_hadd
+    #elif defined(USE_NEON_DOTPROD)
+            using vec_t = int32x4_t;
+        #define vec_setzero() vdupq_n_s32(0)
+        #define vec_add_dpbusd_32(acc, a, b) \
+            SIMD::dotprod_m128_add_dpbusd_epi32(acc, vreinterpretq_s8_s32(a), \
+                                                vreinterpretq_s8_s32(b))
+        #define vec_hadd SIMD::neon_m128_hadd
+    #endif
+
+            const auto inputVector = reinterpret_cast<const vec_t*>(input);
+
+            static constexpr IndexType InputSimdWidth = sizeof(vec_t) / sizeof(InputType);
+
+            static_assert(PaddedInputDimensions % InputSimdWidth == 0);
+
+            constexpr IndexType NumChunks = PaddedInputDimensions / InputSimdWidth;
+            vec_t               sum0      = vec_setzero();
+            const auto          row0      = reinterpret_cast<const vec_t*>(&weights[0]);
+
+            for (int j = 0; j < int(NumChunks); ++j)
+            {
+                const vec_t in = inputVector[j];
+                vec_add_dpbusd_32(sum0, in, row0[j]);
+            }
+            output[0] = vec_hadd(sum0, biases[0]);
+
+    #undef vec_setzero
+    #undef vec_add_dpbusd_32
+    #undef vec_hadd
+        }
+#else
+        // Use old implementation for the other architectures.
+        affine_transform_non_ssse3<InputDimensions, PaddedInputDimensions, OutputDimensions>(
+          output, weights, biases, input);
+#endif
+    }
+
+    // Selects the kernel run by propagate() for all the layers of this type
+    static void select_kernel([[maybe_unused]] DenseKernel k) {
+#ifdef ENABLE_SEQ_OPT
+        kernel = k == DenseKernel::TwoChains   ? &run<2, 1>
+               : k == DenseKernel::HalfOutputs ? &run<1, 2>
+                                               : &run<1, 1>;
+#endif
+    }
+
+    // Forward propagation of Batch inputs together. Each chunk of weights is loaded
+    // once for the whole batch and applied to every input, whose sums are kept in
+    // registers of their own. The outputs are identical to those of propagate().
+    template<IndexType Batch>
+    void propagate_batch(const InputType* const* input, OutputType* const* output) const {
+
 #ifdef ENABLE_SEQ_OPT
 
         if constexpr (OutputDimensions > 1)
@@ -222,35 +294,44 @@ class AffineTransform {
             static_assert(OutputDimensions % OutputSimdWidth == 0);
 
             constexpr IndexType NumChunks = ceil_to_multiple<IndexType>(InputDimensions, 8) / 4;
-            constexpr IndexType NumRegs   = OutputDimensions / OutputSimdWidth;
+            constexpr IndexType NumAccums = OutputDimensions / OutputSimdWidth;
 
-            const auto   input32 = reinterpret_cast<const std::int32_t*>(input);
-            const vec_t* biasvec = reinterpret_cast<const vec_t*>(biases);
-            vec_t        acc[NumRegs];
-            for (IndexType k = 0; k < NumRegs; ++k)
-                acc[k] = biasvec[k];
+            const vec_t*        biasvec = reinterpret_cast<const vec_t*>(biases);
+            const std::int32_t* input32[Batch];
+            vec_t               acc[Batch][NumAccums];
 
-            for (IndexType i = 0; i < NumChunks; ++i)
+            for (IndexType b = 0; b < Batch; ++b)
             {
-                const vec_t in0 = vec_set_32(input32[i]);
-                const auto  col0 =
-                  reinterpret_cast<const vec_t*>(&weights[i * OutputDimensions * 4]);
+                input32[b] = reinterpret_cast<const std::int32_t*>(input[b]);
+                for (IndexType k = 0; k < NumAccums; ++k)
+                    acc[b][k] = biasvec[k];
+            }
 
-                for (IndexType k = 0; k < NumRegs; ++k)
-                    vec_add_dpbusd_32(acc[k], in0, col0[k]);
+            for (IndexType i = 0; i < NumChunks; ++i)
+            {
+                const auto col = reinterpret_cast<const vec_t*>(&weights[i * OutputDimensions * 4]);
+                vec_t      in[Batch];
+
+                for (IndexType b = 0; b < Batch; ++b)
+                    in[b] = vec_set_32(input32[b][i]);
+
+                for (IndexType k = 0; k < NumAccums; ++k)
+                {
+                    const vec_t w = col[k];
+                    for (IndexType b = 0; b < Batch; ++b)
+                        vec_add_dpbusd_32(acc[b][k], in[b], w);
+                }
             }
 
-            vec_t* outptr = reinterpret_cast<vec_t*>(output);
-            for (IndexType k = 0; k < NumRegs; ++k)
-                outptr[k] = acc[k];
+            for (IndexType b = 0; b < Batch; ++b)
+                for (IndexType k = 0; k < NumAccums; ++k)
+                    reinterpret_cast<vec_t*>(output[b])[k] = acc[b][k];
 
     #undef vec_set_32
     #undef vec_add_dpbusd_32
         }
         else if constexpr (OutputDimensions == 1)
         {
-    // We cannot use AVX512 for the last layer because there are only 32 inputs
-    // and the buffer is not padded to 64 elements.
     #if defined(USE_AVX2)
             using vec_t = __m256i;
         #define vec_setzero() _mm256_setzero_si256()
@@ -270,35 +351,139 @@ class AffineTransform {
         #define vec_hadd SIMD::neon_m128_hadd
     #endif
 
-            const auto inputVector = reinterpret_cast<const vec_t*>(input);
-
             static constexpr IndexType InputSimdWidth = sizeof(vec_t) / sizeof(InputType);
 
-            static_assert(PaddedInputDimensions % InputSimdWidth == 0);
-
             constexpr IndexType NumChunks = PaddedInputDimensions / InputSimdWidth;
-            vec_t               sum0      = vec_setzero();
             const auto          row0      = reinterpret_cast<const vec_t*>(&weights[0]);
+            vec_t               sum[Batch];
+
+            for (IndexType b = 0; b < Batch; ++b)
+                sum[b] = vec_setzero();
 
             for (int j = 0; j < int(NumChunks); ++j)
             {
-                const vec_t in = inputVector[j];
-                vec_add_dpbusd_32(sum0, in, row0[j]);
+                const vec_t w = row0[j];
+                for (IndexType b = 0; b < Batch; ++b)
+                    vec_add_dpbusd_32(sum[b], reinterpret_cast<const vec_t*>(input[b])[j], w);
             }
-            output[0] = vec_hadd(sum0, biases[0]);
+
+            for (IndexType b = 0; b < Batch; ++b)
+                output[b][0] = vec_hadd(sum[b], biases[0]);
 
     #undef vec_setzero
     #undef vec_add_dpbusd_32
     #undef vec_hadd
         }
 #else
-        // Use old implementation for the other architectures.
-        affine_transform_non_ssse3<InputDimensions, PaddedInputDimensions, OutputDimensions>(
-          output, weights, biases, input);
+        for (IndexType b = 0; b < Batch; ++b)
+            propagate(input[b], output[b]);
 #endif
     }
 
    private:
+#ifdef ENABLE_SEQ_OPT
+    using Kernel = void (*)(const AffineTransform&, const InputType*, OutputType*);
+
+    template<IndexType Chains, IndexType Blocks>
+    static void run(const AffineTransform& layer, const InputType* input, OutputType* output) {
+        layer.propagate_chains<Chains, Blocks>(input, output);
+    }
+
+    static inline Kernel kernel = &run<1, 1>;
+
+    // Accumulates the input chunks in Chains separate sets of registers, merged at the
+    // end. The outputs are computed in Blocks passes over the input, each one for as
+    // many registers fewer.
+    template<IndexType Chains, IndexType Blocks>
+    void propagate_chains(const InputType* input, OutputType* output) const {
+    #if defined(USE_AVX512)
+        using vec_t = __m512i;
+        #define vec_zero_32() _mm512_setzero_si512()
+        #define vec_add_32 _mm512_add_epi32
+        #define vec_set_32 _mm512_set1_epi32
+        #define vec_add_dpbusd_32 SIMD::m512_add_dpbusd_epi32
+    #elif defined(USE_AVX2)
+        using vec_t = __m256i;
+        #define vec_zero_32() _mm256_setzero_si256()
+        #define vec_add_32 _mm256_add_epi32
+        #define vec_set_32 _mm256_set1_epi32
+        #define vec_add_dpbusd_32 SIMD::m256_add_dpbusd_epi32
+    #elif defined(USE_SSSE3)
+        using vec_t = __m128i;
+        #define vec_zero_32() _mm_setzero_si128()
+        #define vec_add_32 _mm_add_epi32
+        #define vec_set_32 _mm_set1_epi32
+        #define vec_add_dpbusd_32 SIMD::m128_add_dpbusd_epi32
+    #elif defined(USE_NEON_DOTPROD)
+        using vec_t = int32x4_t;
+        #define vec_zero_32() vdupq_n_s32(0)
+        #define vec_add_32 vaddq_s32
+        #define vec_set_32 vdupq_n_s32
+        #define vec_add_dpbusd_32(acc, a, b) \
+            SIMD::dotprod_m128_add_dpbusd_epi32(acc, vreinterpretq_s8_s32(a), \
+                                                vreinterpretq_s8_s32(b))
+    #endif
+
+        static constexpr IndexType OutputSimdWidth = sizeof(vec_t) / sizeof(OutputType);
+
+        static_assert(OutputDimensions % (OutputSimdWidth * Blocks) == 0);
+
+        constexpr IndexType NumChunks = ceil_to_multiple<IndexType>(InputDimensions, 8) / 4;
+        constexpr IndexType NumAccums = OutputDimensions / OutputSimdWidth / Blocks;
+        constexpr IndexType NumRegs   = Chains * NumAccums;
+
+        const auto   input32 = reinterpret_cast<const std::int32_t*>(input);
+        const vec_t* biasvec = reinterpret_cast<const vec_t*>(biases);
+        vec_t*       outptr  = reinterpret_cast<vec_t*>(output);
+
+        for (IndexType first = 0; first < NumAccums * Blocks; first += NumAccums)
+        {
+            vec_t acc[NumRegs];
+            for (IndexType k = 0; k < NumAccums; ++k)
+                acc[k] = biasvec[first + k];
+
+            for (IndexType k = NumAccums; k < NumRegs; ++k)
+                acc[k] = vec_zero_32();
+
+            IndexType i = 0;
+
+            for (; i + Chains <= NumChunks; i += Chains)
+                for (IndexType c = 0; c < Chains; ++c)
+                {
+                    const vec_t in0  = vec_set_32(input32[i + c]);
+                    const auto  col0 = reinterpret_cast<const vec_t*>(
+                      &weights[(i + c) * OutputDimensions * 4]) + first;
+
+                    for (IndexType k = 0; k < NumAccums; ++k)
+                        vec_add_dpbusd_32(acc[k + c * NumAccums], in0, col0[k]);
+                }
+
+            for (; i < NumChunks; ++i)
+            {
+                const vec_t in0 = vec_set_32(input32[i]);
+                const auto  col0 =
+                  reinterpret_cast<const vec_t*>(&weights[i * OutputDimensions * 4]) + first;
+
+                for (IndexType k = 0; k < NumAccums; ++k)
+                    vec_add_dpbusd_32(acc[k], in0, col0[k]);
+            }
+
+            for (IndexType k = 0; k < NumAccums; ++k)
+            {
+                for (IndexType c = 1; c < Chains; ++c)
+                    acc[k] = vec_add_32(acc[k], acc[k + c * NumAccums]);
+
+                outptr[first + k] = acc[k];
+            }
+        }
+
+    #undef vec_zero_32
+    #undef vec_add_32
+    #undef vec_set_32
+    #undef vec_add_dpbusd_32
+    }
+#endif
+
     using BiasType   = OutputType;
     using WeightType = std::int8_t;
 
@@ -254,91 +254,253 @@ class AffineTransformSparseInput {
     void propagate(const InputType* input, OutputType* output) const {
 
 #if (USE_SSSE3 | (USE_NEON >= 8))
+        kernel(*this, input, output);
+#else
+        // Use dense implementation for the other architectures.
+        affine_transform_non_ssse3<InputDimensions, PaddedInputDimensions, OutputDimensions>(
+          output, weights, biases, input);
+#endif
+    }
+
+    // Selects the kernel run by propagate() for all the layers of this type
+    static void select_kernel([[maybe_unused]] SparseKernel k) {
+#if (USE_SSSE3 | (USE_NEON >= 8))
+        kernel = k == SparseKernel::TwoChains   ? &run<2, false>
+               : k == SparseKernel::ThreeChains ? &run<3, false>
+               : k == SparseKernel::BitScan     ? &run<1, true>
+                                                : &run<1, false>;
+#endif
+    }
+
+    // Forward propagation of Batch inputs together, over the chunks that are nonzero
+    // in any of them. Each chunk of weights is loaded once for the whole batch and
+    // applied to every input, a zero chunk adding nothing. The outputs are identical
+    // to those of propagate().
+    template<IndexType Batch>
+    void propagate_batch(const InputType* const* input, OutputType* const* output) const {
+
+#if (USE_SSSE3 | (USE_NEON >= 8))
+
     #if defined(USE_AVX512)
         using invec_t  = __m512i;
         using outvec_t = __m512i;
+        #define vec_set_32 _mm512_set1_epi32
+        #define vec_add_dpbusd_32 SIMD::m512_add_dpbusd_epi32
+    #elif defined(USE_AVX2)
+        using invec_t  = __m256i;
+        using outvec_t = __m256i;
+        #define vec_set_32 _mm256_set1_epi32
+        #define vec_add_dpbusd_32 SIMD::m256_add_dpbusd_epi32
+    #elif defined(USE_SSSE3)
+        using invec_t  = __m128i;
+        using outvec_t = __m128i;
+        #define vec_set_32 _mm_set1_epi32
+        #define vec_add_dpbusd_32 SIMD::m128_add_dpbusd_epi32
+    #elif defined(USE_NEON_DOTPROD)
+        using invec_t  = int8x16_t;
+        using outvec_t = int32x4_t;
+        #define vec_set_32(a) vreinterpretq_s8_u32(vdupq_n_u32(a))
+        #define vec_add_dpbusd_32 SIMD::dotprod_m128_add_dpbusd_epi32
+    #elif defined(USE_NEON)
+        using invec_t  = int8x16_t;
+        using outvec_t = int32x4_t;
+        #define vec_set_32(a) vreinterpretq_s8_u32(vdupq_n_u32(a))
+        #define vec_add_dpbusd_32 SIMD::neon_m128_add_dpbusd_epi32
+    #endif
+        constexpr IndexType OutputSimdWidth = sizeof(outvec_t) / sizeof(OutputType);
+        constexpr IndexType NumChunks = ceil_to_multiple<IndexType>(InputDimensions, 8) / ChunkSize;
+        constexpr IndexType NumAccums = OutputDimensions / OutputSimdWidth;
+
+        alignas(CacheLineSize) std::int32_t anyNonZero[NumChunks];
+        std::uint16_t                       nnz[NumChunks];
+        IndexType                           count;
+        const std::int32_t*                 input32[Batch];
+
+        for (IndexType b = 0; b < Batch; ++b)
+            input32[b] = reinterpret_cast<const std::int32_t*>(input[b]);
+
+        for (IndexType i = 0; i < NumChunks; ++i)
+        {
+            anyNonZero[i] = input32[0][i];
+            for (IndexType b = 1; b < Batch; ++b)
+                anyNonZero[i] |= input32[b][i];
+        }
+
+        find_nnz<NumChunks>(anyNonZero, nnz, count);
+
+        const outvec_t* biasvec = reinterpret_cast<const outvec_t*>(biases);
+        outvec_t        acc[Batch][NumAccums];
+
+        for (IndexType b = 0; b < Batch; ++b)
+            for (IndexType k = 0; k < NumAccums; ++k)
+                acc[b][k] = biasvec[k];
+
+        const std::int8_t* weights_cp = weights;
+
+        for (IndexType j = 0; j < count; ++j)
+        {
+            const std::ptrdiff_t i = nnz[j];
+            const auto           col =
+              reinterpret_cast<const invec_t*>(&weights_cp[i * OutputDimensions * ChunkSize]);
+            invec_t in[Batch];
+
+            for (IndexType b = 0; b < Batch; ++b)
+                in[b] = vec_set_32(input32[b][i]);
+
+            for (IndexType k = 0; k < NumAccums; ++k)
+            {
+                const invec_t w = col[k];
+                for (IndexType b = 0; b < Batch; ++b)
+                    vec_add_dpbusd_32(acc[b][k], in[b], w);
+            }
+        }
+
+        for (IndexType b = 0; b < Batch; ++b)
+            for (IndexType k = 0; k < NumAccums; ++k)
+                reinterpret_cast<outvec_t*>(output[b])[k] = acc[b][k];
+
+    #undef vec_set_32
+    #undef vec_add_dpbusd_32
+#else
+        for (IndexType b = 0; b < Batch; ++b)
+            propagate(input[b], output[b]);
+#endif
+    }
+
+   private:
+#if (USE_SSSE3 | (USE_NEON >= 8))
+    using Kernel = void (*)(const AffineTransformSparseInput&, const InputType*, OutputType*);
+
+    template<IndexType Chains, bool BitScan>
+    static void run(const AffineTransformSparseInput& layer,
+                    const InputType*                  input,
+                    OutputType*                       output) {
+        layer.propagate_chains<Chains, BitScan>(input, output);
+    }
+
+    static inline Kernel kernel =
+      DefaultKernels.sparse == SparseKernel::ThreeChains ? &run<3, false> : &run<1, false>;
+
+    // Accumulates the nonzero input chunks in Chains separate sets of registers, merged
+    // at the end. With high-latency dot product instructions, such as VNNI, this
+    // creates independent dependency chains. With BitScan, the nonzero chunks are
+    // visited straight from the bitmask of each input vector instead of being listed
+    // by find_nnz() first.
+    template<IndexType Chains, bool BitScan>
+    void propagate_chains(const InputType* input, OutputType* output) const {
+
+    #if defined(USE_AVX512)
+        using invec_t  = __m512i;
+        using outvec_t = __m512i;
+        #define vec_zero_32() _mm512_setzero_si512()
         #define vec_add_32 _mm512_add_epi32
         #define vec_set_32 _mm512_set1_epi32
         #define vec_add_dpbusd_32 SIMD::m512_add_dpbusd_epi32
     #elif defined(USE_AVX2)
         using invec_t  = __m256i;
         using outvec_t = __m256i;
+        #define vec_zero_32() _mm256_setzero_si256()
         #define vec_add_32 _mm256_add_epi32
         #define vec_set_32 _mm256_set1_epi32
         #define vec_add_dpbusd_32 SIMD::m256_add_dpbusd_epi32
     #elif defined(USE_SSSE3)
         using invec_t  = __m128i;
         using outvec_t = __m128i;
+        #define vec_zero_32() _mm_setzero_si128()
+        #define vec_add_32 _mm_add_epi32
         #define vec_set_32 _mm_set1_epi32
         #define vec_add_dpbusd_32 SIMD::m128_add_dpbusd_epi32
     #elif defined(USE_NEON_DOTPROD)
         using invec_t  = int8x16_t;
         using outvec_t = int32x4_t;
+        #define vec_zero_32() vdupq_n_s32(0)
+        #define vec_add_32 vaddq_s32
         #define vec_set_32(a) vreinterpretq_s8_u32(vdupq_n_u32(a))
         #define vec_add_dpbusd_32 SIMD::dotprod_m128_add_dpbusd_epi32
     #elif defined(USE_NEON)
         using invec_t  = int8x16_t;
         using outvec_t = int32x4_t;
+        #define vec_zero_32() vdupq_n_s32(0)
+        #define vec_add_32 vaddq_s32
         #define vec_set_32(a) vreinterpretq_s8_u32(vdupq_n_u32(a))
         #define vec_add_dpbusd_32 SIMD::neon_m128_add_dpbusd_epi32
     #endif
         constexpr IndexType OutputSimdWidth = sizeof(outvec_t) / sizeof(OutputType);
         constexpr IndexType NumChunks = ceil_to_multiple<IndexType>(InputDimensions, 8) / ChunkSize;
         constexpr IndexType NumAccums = OutputDimensions / OutputSimdWidth;
-        // If we're using high-latency dot product instructions, split the accumulators
-        // to create 3 separate dependency chains and merge at the end
-        constexpr IndexType NumRegs =
-    #if defined(USE_VNNI)
-          3 * NumAccums;
-    #else
-          NumAccums;
-    #endif
+        constexpr IndexType NumRegs   = Chains * NumAccums;
+
         std::uint16_t nnz[NumChunks];
-        IndexType     count;
+        IndexType     count = 0;
 
         const auto input32 = reinterpret_cast<const std::int32_t*>(input);
 
         // Find indices of nonzero 32-bit blocks
-        find_nnz<NumChunks>(input32, nnz, count);
+        if constexpr (!BitScan)
+            find_nnz<NumChunks>(input32, nnz, count);
 
         const outvec_t* biasvec = reinterpret_cast<const outvec_t*>(biases);
         outvec_t        acc[NumRegs];
         for (IndexType k = 0; k < NumAccums; ++k)
             acc[k] = biasvec[k];
 
+        for (IndexType k = NumAccums; k < NumRegs; ++k)
+            acc[k] = vec_zero_32();
+
         const auto* start = nnz;
         const auto* end   = nnz + count;
 
         // convince GCC to not do weird pointer arithmetic in the following loop
         const std::int8_t* weights_cp = weights;
-    #if defined(USE_VNNI)
-        for (IndexType k = NumAccums; k < NumRegs; ++k)
-            acc[k] = vec_zero();
 
-        while (start < end - 2)
+        if constexpr (BitScan)
         {
-            const std::ptrdiff_t i0  = *start++;
-            const std::ptrdiff_t i1  = *start++;
-            const std::ptrdiff_t i2  = *start++;
-            const invec_t        in0 = vec_set_32(input32[i0]);
-            const invec_t        in1 = vec_set_32(input32[i1]);
-            const invec_t        in2 = vec_set_32(input32[i2]);
-            const auto           col0 =
-              reinterpret_cast<const invec_t*>(&weights_cp[i0 * OutputDimensions * ChunkSize]);
-            const auto col1 =
-              reinterpret_cast<const invec_t*>(&weights_cp[i1 * OutputDimensions * ChunkSize]);
-            const auto col2 =
-              reinterpret_cast<const invec_t*>(&weights_cp[i2 * OutputDimensions * ChunkSize]);
-            for (IndexType k = 0; k < NumAccums; ++k)
+            using SIMD::vec_uint_t;
+
+            constexpr IndexType InputSimdWidth = sizeof(vec_uint_t) / sizeof(std::int32_t);
+
+            static_assert(NumChunks % InputSimdWidth == 0);
+
+            const auto inputVector = reinterpret_cast<const vec_uint_t*>(input);
+
+            for (IndexType i = 0; i < NumChunks / InputSimdWidth; ++i)
+                for (Bitboard b = Bitboard(vec_nnz(inputVector[i])); b; b &= b - 1)
+                {
+                    const std::ptrdiff_t j   = i * InputSimdWidth + lsb(b);
+                    const invec_t        in  = vec_set_32(input32[j]);
+                    const auto           col = reinterpret_cast<const invec_t*>(
+                      &weights_cp[j * OutputDimensions * ChunkSize]);
+                    for (IndexType k = 0; k < NumAccums; ++k)
+                        vec_add_dpbusd_32(acc[k], in, col[k]);
+                }
+        }
+
+        if constexpr (Chains > 1)
+        {
+            while (end - start >= std::ptrdiff_t(Chains))
             {
-                vec_add_dpbusd_32(acc[k], in0, col0[k]);
-                vec_add_dpbusd_32(acc[k + NumAccums], in1, col1[k]);
-                vec_add_dpbusd_32(acc[k + 2 * NumAccums], in2, col2[k]);
+                invec_t        in[Chains];
+                const invec_t* col[Chains];
+
+                for (IndexType c = 0; c < Chains; ++c)
+                {
+                    const std::ptrdiff_t i = *start++;
+
+                    in[c]  = vec_set_32(input32[i]);
+                    col[c] = reinterpret_cast<const invec_t*>(
+                      &weights_cp[i * OutputDimensions * ChunkSize]);
+                }
+
+                for (IndexType k = 0; k < NumAccums; ++k)
+                    for (IndexType c = 0; c < Chains; ++c)
+                        vec_add_dpbusd_32(acc[k + c * NumAccums], in[c], col[c][k]);
             }
+
+            for (IndexType k = 0; k < NumAccums; ++k)
+                for (IndexType c = 1; c < Chains; ++c)
+                    acc[k] = vec_add_32(acc[k], acc[k + c * NumAccums]);
         }
-        for (IndexType k = 0; k < NumAccums; ++k)
-            acc[k] = vec_add_32(vec_add_32(acc[k], acc[k + NumAccums]), acc[k + 2 * NumAccums]);
-    #endif
+
         while (start < end)
         {
             const std::ptrdiff_t i  = *start++;
@@ -353,19 +515,13 @@ class AffineTransformSparseInput {
         for (IndexType k = 0; k < NumAccums; ++k)
             outptr[k] = acc[k];
 
+    #undef vec_zero_32
+    #undef vec_add_32
     #undef vec_set_32
     #undef vec_add_dpbusd_32
-    #ifdef vec_add_32
-        #undef vec_add_32
-    #endif
-#else
-        // Use dense implementation for the other architectures.
-        affine_transform_non_ssse3<InputDimensions, PaddedInputDimensions, OutputDimensions>(
-          output, weights, biases, input);
-#endif
     }
+#endif
 
-   private:
     using BiasType   = OutputType;
     using WeightType = std::int8_t;
 
@@ -18,6 +18,7 @@
 
 #include "network.h"
 
+#include <chrono>
 #include <cstdlib>
 #include <fstream>
 #include <iostream>
@@ -29,6 +30,7 @@
 #include "../incbin/incbin.h"
 
 #include "../evaluate.h"
+#include "../memory.h"
 #include "../misc.h"
 #include "../position.h"
 #include "../types.h"
@@ -78,6 +80,11 @@ EmbeddedNNUE get_embedded(EmbeddedNNUEType type) {
         return EmbeddedNNUE(gEmbeddedNNUESmallData, gEmbeddedNNUESmallEnd, gEmbeddedNNUESmallSize);
 }
 
+#if defined(NNUE_PROFILE)
+// Set by each searching thread, see collect_profile()
+thread_local EvalProfile* threadProfile = nullptr;
+#endif
+
 }
 
 
@@ -87,22 +94,22 @@ namespace Stockfish::Eval::NNUE {
 namespace Detail {
 
 // Read evaluation function parameters
-template<typename T>
-bool read_parameters(std::istream& stream, T& reference) {
+template<typename T, typename... Args>
+bool read_parameters(std::istream& stream, T& reference, Args... args) {
 
     std::uint32_t header;
     header = read_little_endian<std::uint32_t>(stream);
     if (!stream || header != T::get_hash_value())
         return false;
-    return reference.read_parameters(stream);
+    return reference.read_parameters(stream, args...);
 }
 
 // Write evaluation function parameters
-template<typename T>
-bool write_parameters(std::ostream& stream, const T& reference) {
+template<typename T, typename... Args>
+bool write_parameters(std::ostream& stream, const T& reference, Args... args) {
 
     write_little_endian<std::uint32_t>(stream, T::get_hash_value());
-    return reference.write_parameters(stream);
+    return reference.write_parameters(stream, args...);
 }
 
 }  // namespace Detail
@@ -138,7 +145,8 @@ void Network<Arch, Transformer>::load(const std::string& rootDirectory, std::str
 
 
 template<typename Arch, typename Transformer>
-bool Network<Arch, Transformer>::save(const std::optional<std::string>& filename) const {
+bool Network<Arch, Transformer>::save(const std::optional<std::string>& filename,
+                                      bool                              compressedThreats) const {
     std::string actualFilename;
     std::string msg;
 
@@ -159,7 +167,7 @@ bool Network<Arch, Transformer>::save(const std::optional<std::string>& filename
     }
 
     std::ofstream stream(actualFilename, std::ios_base::binary);
-    bool          saved = save(stream, evalFile.current, evalFile.netDescription);
+    bool          saved = save(stream, evalFile.current, evalFile.netDescription, compressedThreats);
 
     msg = saved ? "Network saved successfully to " + actualFilename : "Failed to export a net";
 
@@ -181,14 +189,140 @@ Network<Arch, Transformer>::evaluate(const Position&                         pos
 
     ASSERT_ALIGNED(transformedFeatures, alignment);
 
-    const int  bucket = (pos.count<ALL_PIECES>() - 1) / 4;
+    const int bucket = (pos.count<ALL_PIECES>() - 1) / 4;
+
+    NetworkProfile* profile = nullptr;
+#if defined(NNUE_PROFILE)
+    if (threadProfile)
+        profile = FTDimensions == TransformedFeatureDimensionsBig ? &threadProfile->big
+                                                                  : &threadProfile->small;
+#endif
+
+    ProfileTimer timer(profile);
+
     const auto psqt =
       featureTransformer.transform(pos, accumulatorStack, cache, transformedFeatures, bucket);
-    const auto positional = network[bucket].propagate(transformedFeatures);
+    timer.lap(FeatureTransform);
+
+    const auto positional = network[bucket].propagate(transformedFeatures, profile);
     return {static_cast<Value>(psqt / OutputScale), static_cast<Value>(positional / OutputScale)};
 }
 
 
+template<typename Arch, typename Transformer>
+void Network<Arch, Transformer>::evaluate_batch(const Position* const* positions,
+                                                std::size_t            count,
+                                                AccumulatorStack&      accumulatorStack,
+                                                AccumulatorCaches::Cache<FTDimensions>& cache,
+                                                NetworkOutput* output) const {
+
+    constexpr uint64_t    alignment = CacheLineSize;
+    constexpr std::size_t Stride    = FeatureTransformer<FTDimensions>::BufferSize;
+    constexpr std::size_t MaxBatch  = Arch::MaxBatch;
+
+    alignas(alignment) static thread_local TransformedFeatureType
+      transformedFeatures[MaxBatch][Stride];
+
+    ASSERT_ALIGNED(transformedFeatures, alignment);
+
+    std::int32_t psqts[MaxBatch], positionals[MaxBatch];
+    std::size_t  indices[MaxBatch];
+
+    // The positions are unrelated, so the accumulators are refreshed for each of them
+    for (int bucket = 0; bucket < int(LayerStacks); ++bucket)
+    {
+        std::size_t n = 0;
+
+        for (std::size_t i = 0; i <= count; ++i)
+        {
+            if (n == MaxBatch || (i == count && n))
+            {
+                network[bucket].propagate_batch(transformedFeatures[0], Stride, n, positionals);
+
+                for (std::size_t j = 0; j < n; ++j)
+                    output[indices[j]] = {static_cast<Value>(psqts[j] / OutputScale),
+                                          static_cast<Value>(positionals[j] / OutputScale)};
+                n = 0;
+            }
+
+            if (i == count || (positions[i]->count<ALL_PIECES>() - 1) / 4 != bucket)
+                continue;
+
+            accumulatorStack.reset();
+            indices[n] = i;
+            psqts[n]   = featureTransformer.transform(*positions[i], accumulatorStack, cache,
+                                                      transformedFeatures[n], bucket);
+            ++n;
+        }
+    }
+}
+
+
+template<typename Arch, typename Transformer>
+std::uint64_t
+Network<Arch, Transformer>::time_propagation(const Position* const* positions,
+                                             std::size_t            count,
+                                             AccumulatorStack&      accumulatorStack,
+                                             AccumulatorCaches::Cache<FTDimensions>& cache,
+                                             int                                     rounds,
+                                             bool batched) const {
+
+    struct alignas(CacheLineSize) Features {
+        TransformedFeatureType data[FeatureTransformer<FTDimensions>::BufferSize];
+    };
+
+    constexpr std::size_t Stride   = sizeof(Features) / sizeof(TransformedFeatureType);
+    constexpr std::size_t MaxBatch = Arch::MaxBatch;
+
+    auto             features = make_unique_aligned<Features[]>(count);
+    std::vector<int> buckets;
+
+    // Only the layers are timed, on the outputs of the feature transformer. These are
+    // grouped by layer stack in both modes, as evaluate_batch() groups them.
+    for (int bucket = 0; bucket < int(LayerStacks); ++bucket)
+        for (std::size_t i = 0; i < count; ++i)
+            if ((positions[i]->count<ALL_PIECES>() - 1) / 4 == bucket)
+            {
+                accumulatorStack.reset();
+                featureTransformer.transform(*positions[i], accumulatorStack, cache,
+                                             features[buckets.size()].data, bucket);
+                buckets.push_back(bucket);
+            }
+
+    std::int32_t outputs[MaxBatch];
+
+    auto start = std::chrono::steady_clock::now();
+
+    // The outputs are dropped, propagate() still writes its thread local buffers
+    for (int r = 0; r < rounds; ++r)
+        if (batched)
+            for (std::size_t i = 0, n; i < count; i += n)
+            {
+                n = 1;
+                while (n < MaxBatch && i + n < count && buckets[i + n] == buckets[i])
+                    ++n;
+
+                network[buckets[i]].propagate_batch(features[i].data, Stride, n, outputs);
+            }
+        else
+            for (std::size_t i = 0; i < count; ++i)
+                network[buckets[i]].propagate(features[i].data);
+
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    return std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+template<typename Arch, typename Transformer>
+void Network<Arch, Transformer>::time_accumulator_updates(
+  const Position&                         pos,
+  AccumulatorStack&                       accumulatorStack,
+  AccumulatorCaches::Cache<FTDimensions>& cache,
+  AccumulatorTimings&                     timings) const {
+    accumulatorStack.time_updates(pos, featureTransformer, cache, timings);
+}
+
+
 template<typename Arch, typename Transformer>
 void Network<Arch, Transformer>::verify(std::string                                  evalfilePath,
                                         const std::function<void(std::string_view)>& f) const {
@@ -309,11 +443,12 @@ void Network<Arch, Transformer>::initialize() {
 template<typename Arch, typename Transformer>
 bool Network<Arch, Transformer>::save(std::ostream&      stream,
                                       const std::string& name,
-                                      const std::string& netDescription) const {
+                                      const std::string& netDescription,
+                                      bool               compressedThreats) const {
     if (name.empty() || name == "None")
         return false;
 
-    return write_parameters(stream, netDescription);
+    return write_parameters(stream, netDescription, compressedThreats);
 }
 
 
@@ -344,14 +479,16 @@ std::size_t Network<Arch, Transformer>::get_content_hash() const {
 template<typename Arch, typename Transformer>
 bool Network<Arch, Transformer>::read_header(std::istream&  stream,
                                              std::uint32_t* hashValue,
-                                             std::string*   desc) const {
+                                             std::string*   desc,
+                                             bool*          compressedThreats) const {
     std::uint32_t version, size;
 
     version    = read_little_endian<std::uint32_t>(stream);
     *hashValue = read_little_endian<std::uint32_t>(stream);
     size       = read_little_endian<std::uint32_t>(stream);
-    if (!stream || version != Version)
+    if (!stream || (version != Version && version != CompressedVersion))
         return false;
+    *compressedThreats = version == CompressedVersion;
     desc->resize(size);
     stream.read(&(*desc)[0], size);
     return !stream.fail();
@@ -362,8 +499,9 @@ bool Network<Arch, Transformer>::read_header(std::istream&  stream,
 template<typename Arch, typename Transformer>
 bool Network<Arch, Transformer>::write_header(std::ostream&      stream,
                                               std::uint32_t      hashValue,
-                                              const std::string& desc) const {
-    write_little_endian<std::uint32_t>(stream, Version);
+                                              const std::string& desc,
+                                              bool               compressedThreats) const {
+    write_little_endian<std::uint32_t>(stream, compressedThreats ? CompressedVersion : Version);
     write_little_endian<std::uint32_t>(stream, hashValue);
     write_little_endian<std::uint32_t>(stream, std::uint32_t(desc.size()));
     stream.write(&desc[0], desc.size());
@@ -375,11 +513,12 @@ template<typename Arch, typename Transformer>
 bool Network<Arch, Transformer>::read_parameters(std::istream& stream,
                                                  std::string&  netDescription) {
     std::uint32_t hashValue;
-    if (!read_header(stream, &hashValue, &netDescription))
+    bool          compressedThreats;
+    if (!read_header(stream, &hashValue, &netDescription, &compressedThreats))
         return false;
     if (hashValue != Network::hash)
         return false;
-    if (!Detail::read_parameters(stream, featureTransformer))
+    if (!Detail::read_parameters(stream, featureTransformer, compressedThreats))
         return false;
     for (std::size_t i = 0; i < LayerStacks; ++i)
     {
@@ -392,10 +531,11 @@ bool Network<Arch, Transformer>::read_parameters(std::istream& stream,
 
 template<typename Arch, typename Transformer>
 bool Network<Arch, Transformer>::write_parameters(std::ostream&      stream,
-                                                  const std::string& netDescription) const {
-    if (!write_header(stream, Network::hash, netDescription))
+                                                  const std::string& netDescription,
+                                                  bool               compressedThreats) const {
+    if (!write_header(stream, Network::hash, netDescription, compressedThreats))
         return false;
-    if (!Detail::write_parameters(stream, featureTransformer))
+    if (!Detail::write_parameters(stream, featureTransformer, compressedThreats))
         return false;
     for (std::size_t i = 0; i < LayerStacks; ++i)
     {
@@ -405,6 +545,12 @@ bool Network<Arch, Transformer>::write_parameters(std::ostream&      stream,
     return bool(stream);
 }
 
+void collect_profile([[maybe_unused]] EvalProfile* profile) {
+#if defined(NNUE_PROFILE)
+    threadProfile = profile;
+#endif
+}
+
 // Explicit template instantiations
 
 template class Network<NetworkArchitecture<TransformedFeatureDimensionsBig, L2Big, L3Big>,
@@ -51,6 +51,12 @@ enum class EmbeddedNNUEType {
 
 using NetworkOutput = std::tuple<Value, Value>;
 
+// Time taken by the networks with a choice of layer kernels
+struct KernelTiming {
+    LayerKernels  kernels;
+    std::uint64_t nanoseconds;
+};
+
 // The network must be a trivial type, i.e. the memory must be in-line.
 // This is required to allow sharing the network via shared memory, as
 // there is no way to run destructors.
@@ -70,7 +76,23 @@ class Network {
     Network& operator=(Network&& other)      = default;
 
     void load(const std::string& rootDirectory, std::string evalfilePath);
-    bool save(const std::optional<std::string>& filename) const;
+    bool save(const std::optional<std::string>& filename, bool compressedThreats = false) const;
+
+    // Number of distinct rows of threat weights, smaller than the number of threat
+    // features when the network was loaded from a file with compressed threats
+    std::size_t threat_weight_rows() const { return featureTransformer.threatRowCount; }
+    bool        shares_threat_rows() const {
+        return featureTransformer.threatRowCount < Transformer::ThreatInputDimensions;
+    }
+
+    // Lets threat features with identical weights share a row, or gives each its own
+    // row again. Both layouts evaluate the same.
+    void share_threat_rows(bool share) {
+        if (share)
+            featureTransformer.share_threat_rows();
+        else
+            featureTransformer.expand_threat_rows();
+    }
 
     std::size_t get_content_hash() const;
 
@@ -78,6 +100,27 @@ class Network {
                            AccumulatorStack&                       accumulatorStack,
                            AccumulatorCaches::Cache<FTDimensions>& cache) const;
 
+    // Evaluate unrelated positions, grouped by layer stack and propagated together
+    void evaluate_batch(const Position* const*                  positions,
+                        std::size_t                             count,
+                        AccumulatorStack&                       accumulatorStack,
+                        AccumulatorCaches::Cache<FTDimensions>& cache,
+                        NetworkOutput*                          output) const;
+
+    // Time to propagate the positions through the layers `rounds` times, in nanoseconds,
+    // one at a time or in batches as evaluate_batch() does
+    std::uint64_t time_propagation(const Position* const*                  positions,
+                                   std::size_t                             count,
+                                   AccumulatorStack&                       accumulatorStack,
+                                   AccumulatorCaches::Cache<FTDimensions>& cache,
+                                   int                                     rounds,
+                                   bool                                    batched = false) const;
+
+    // Time each kind of update of the accumulators of the latest position on the stack
+    void time_accumulator_updates(const Position&                         pos,
+                                  AccumulatorStack&                       accumulatorStack,
+                                  AccumulatorCaches::Cache<FTDimensions>& cache,
+                                  AccumulatorTimings&                     timings) const;
 
     void verify(std::string evalfilePath, const std::function<void(std::string_view)>&) const;
     NnueEvalTrace trace_evaluate(const Position&                         pos,
@@ -90,14 +133,15 @@ class Network {
 
     void initialize();
 
-    bool                       save(std::ostream&, const std::string&, const std::string&) const;
+    bool save(std::ostream&, const std::string&, const std::string&, bool) const;
+
     std::optional<std::string> load(std::istream&);
 
-    bool read_header(std::istream&, std::uint32_t*, std::string*) const;
-    bool write_header(std::ostream&, std::uint32_t, const std::string&) const;
+    bool read_header(std::istream&, std::uint32_t*, std::string*, bool*) const;
+    bool write_header(std::ostream&, std::uint32_t, const std::string&, bool) const;
 
     bool read_parameters(std::istream&, std::string&);
-    bool write_parameters(std::ostream&, const std::string&) const;
+    bool write_parameters(std::ostream&, const std::string&, bool) const;
 
     // Input feature converter
     Transformer featureTransformer;
@@ -138,6 +182,10 @@ struct Networks {
     NetworkSmall small;
 };
 
+// Profile the evaluations of the calling thread in the given counters, from now on.
+// Without NNUE_PROFILE nothing is gathered, and evaluate() is left untouched.
+void collect_profile(EvalProfile* profile);
+
 
 }  // namespace Stockfish
 
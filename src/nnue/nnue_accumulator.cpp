@@ -19,9 +19,11 @@
 #include "nnue_accumulator.h"
 
 #include <cassert>
+#include <chrono>
 #include <cstdint>
 #include <new>
 #include <type_traits>
+#include <vector>
 
 #include "../bitboard.h"
 #include "../misc.h"
@@ -40,24 +42,24 @@ using namespace SIMD;
 namespace {
 
 template<IndexType TransformedFeatureDimensions>
-void double_inc_update(Color                                                   perspective,
-                       const FeatureTransformer<TransformedFeatureDimensions>& featureTransformer,
-                       const Square                                            ksq,
-                       AccumulatorState<PSQFeatureSet>&                        middle_state,
-                       AccumulatorState<PSQFeatureSet>&                        target_state,
-                       const AccumulatorState<PSQFeatureSet>&                  computed);
+int double_inc_update(Color                                                   perspective,
+                      const FeatureTransformer<TransformedFeatureDimensions>& featureTransformer,
+                      const Square                                            ksq,
+                      AccumulatorState<PSQFeatureSet>&                        middle_state,
+                      AccumulatorState<PSQFeatureSet>&                        target_state,
+                      const AccumulatorState<PSQFeatureSet>&                  computed);
 
 template<IndexType TransformedFeatureDimensions>
-void double_inc_update(Color                                                   perspective,
-                       const FeatureTransformer<TransformedFeatureDimensions>& featureTransformer,
-                       const Square                                            ksq,
-                       AccumulatorState<ThreatFeatureSet>&                     middle_state,
-                       AccumulatorState<ThreatFeatureSet>&                     target_state,
-                       const AccumulatorState<ThreatFeatureSet>&               computed,
-                       const DirtyPiece&                                       dp2);
+int double_inc_update(Color                                                   perspective,
+                      const FeatureTransformer<TransformedFeatureDimensions>& featureTransformer,
+                      const Square                                            ksq,
+                      AccumulatorState<ThreatFeatureSet>&                     middle_state,
+                      AccumulatorState<ThreatFeatureSet>&                     target_state,
+                      const AccumulatorState<ThreatFeatureSet>&               computed,
+                      const DirtyPiece&                                       dp2);
 
 template<bool Forward, typename FeatureSet, IndexType TransformedFeatureDimensions>
-void update_accumulator_incremental(
+int update_accumulator_incremental(
   Color                                                   perspective,
   const FeatureTransformer<TransformedFeatureDimensions>& featureTransformer,
   const Square                                            ksq,
@@ -65,17 +67,18 @@ void update_accumulator_incremental(
   const AccumulatorState<FeatureSet>&                     computed);
 
 template<IndexType Dimensions>
-void update_accumulator_refresh_cache(Color                                 perspective,
-                                      const FeatureTransformer<Dimensions>& featureTransformer,
-                                      const Position&                       pos,
-                                      AccumulatorState<PSQFeatureSet>&      accumulatorState,
-                                      AccumulatorCaches::Cache<Dimensions>& cache);
-
-template<IndexType Dimensions>
-void update_threats_accumulator_full(Color                                 perspective,
+int update_accumulator_refresh_cache(Color                                 perspective,
                                      const FeatureTransformer<Dimensions>& featureTransformer,
                                      const Position&                       pos,
-                                     AccumulatorState<ThreatFeatureSet>&   accumulatorState);
+                                     AccumulatorState<PSQFeatureSet>&      accumulatorState,
+                                     AccumulatorCaches::Cache<Dimensions>& cache);
+
+template<IndexType Dimensions>
+int update_threats_accumulator_full(Color                                 perspective,
+                                    const FeatureTransformer<Dimensions>& featureTransformer,
+                                    const Position&                       pos,
+                                    AccumulatorState<ThreatFeatureSet>&   accumulatorState);
+
 }
 
 template<typename T>
@@ -164,6 +167,8 @@ void AccumulatorStack::evaluate_side(Color                                 persp
     const auto last_usable_accum =
       find_last_usable_accumulator<FeatureSet, Dimensions>(perspective);
 
+    count(&AccumulatorStats::updates, 0);
+
     if ((accumulators<FeatureSet>()[last_usable_accum].template acc<Dimensions>())
           .computed[perspective])
         forward_update_incremental<FeatureSet>(perspective, pos, featureTransformer,
@@ -172,11 +177,18 @@ void AccumulatorStack::evaluate_side(Color                                 persp
     else
     {
         if constexpr (std::is_same_v<FeatureSet, PSQFeatureSet>)
-            update_accumulator_refresh_cache(perspective, featureTransformer, pos,
-                                             mut_latest<PSQFeatureSet>(), cache);
+        {
+            [[maybe_unused]] const int rows = update_accumulator_refresh_cache(
+              perspective, featureTransformer, pos, mut_latest<PSQFeatureSet>(), cache);
+            count(&AccumulatorStats::refreshes, rows);
+#if defined(NNUE_PROFILE)
+            updateStats.refreshRows += rows;
+#endif
+        }
         else
-            update_threats_accumulator_full(perspective, featureTransformer, pos,
-                                            mut_latest<ThreatFeatureSet>());
+            count(&AccumulatorStats::threatRebuilds,
+                  update_threats_accumulator_full(perspective, featureTransformer, pos,
+                                                  mut_latest<ThreatFeatureSet>()));
 
         backward_update_incremental<FeatureSet>(perspective, pos, featureTransformer,
                                                 last_usable_accum);
@@ -226,8 +238,10 @@ void AccumulatorStack::forward_update_incremental(
                 if (dp2.remove_sq != SQ_NONE
                     && (accumulators[next].diff.threateningSqs & square_bb(dp2.remove_sq)))
                 {
-                    double_inc_update(perspective, featureTransformer, ksq, accumulators[next],
-                                      accumulators[next + 1], accumulators[next - 1], dp2);
+                    count(&AccumulatorStats::forward,
+                          double_inc_update(perspective, featureTransformer, ksq,
+                                            accumulators[next], accumulators[next + 1],
+                                            accumulators[next - 1], dp2));
                     next++;
                     continue;
                 }
@@ -239,8 +253,10 @@ void AccumulatorStack::forward_update_incremental(
                 {
                     const Square captureSq = dp1.to;
                     dp1.to = dp2.remove_sq = SQ_NONE;
-                    double_inc_update(perspective, featureTransformer, ksq, accumulators[next],
-                                      accumulators[next + 1], accumulators[next - 1]);
+                    count(&AccumulatorStats::forward,
+                          double_inc_update(perspective, featureTransformer, ksq,
+                                            accumulators[next], accumulators[next + 1],
+                                            accumulators[next - 1]));
                     dp1.to = dp2.remove_sq = captureSq;
                     next++;
                     continue;
@@ -248,9 +264,10 @@ void AccumulatorStack::forward_update_incremental(
             }
         }
 
-        update_accumulator_incremental<true>(perspective, featureTransformer, ksq,
-                                             mut_accumulators<FeatureSet>()[next],
-                                             accumulators<FeatureSet>()[next - 1]);
+        count(&AccumulatorStats::forward,
+              update_accumulator_incremental<true>(perspective, featureTransformer, ksq,
+                                                   mut_accumulators<FeatureSet>()[next],
+                                                   accumulators<FeatureSet>()[next - 1]));
     }
 
     assert((latest<PSQFeatureSet>().acc<Dimensions>()).computed[perspective]);
@@ -271,9 +288,12 @@ void AccumulatorStack::backward_update_incremental(
     const Square ksq = pos.square<KING>(perspective);
 
     for (std::int64_t next = std::int64_t(size) - 2; next >= std::int64_t(end); next--)
-        update_accumulator_incremental<false>(perspective, featureTransformer, ksq,
-                                              mut_accumulators<FeatureSet>()[next],
-                                              accumulators<FeatureSet>()[next + 1]);
+    {
+        count(&AccumulatorStats::backward,
+              update_accumulator_incremental<false>(perspective, featureTransformer, ksq,
+                                                    mut_accumulators<FeatureSet>()[next],
+                                                    accumulators<FeatureSet>()[next + 1]));
+    }
 
     assert((accumulators<FeatureSet>()[end].template acc<Dimensions>()).computed[perspective]);
 }
@@ -373,7 +393,7 @@ struct AccumulatorUpdateContext {
             for (int i = 0; i < removed.ssize(); ++i)
             {
                 size_t       index  = removed[i];
-                const size_t offset = Dimensions * index;
+                const size_t offset = Dimensions * featureTransformer.threat_row(index);
                 auto*        column = reinterpret_cast<const vec_i8_t*>(&threatWeights[offset]);
 
     #ifdef USE_NEON
@@ -391,7 +411,7 @@ struct AccumulatorUpdateContext {
             for (int i = 0; i < added.ssize(); ++i)
             {
                 size_t       index  = added[i];
-                const size_t offset = Dimensions * index;
+                const size_t offset = Dimensions * featureTransformer.threat_row(index);
                 auto*        column = reinterpret_cast<const vec_i8_t*>(&threatWeights[offset]);
 
     #ifdef USE_NEON
@@ -455,7 +475,7 @@ struct AccumulatorUpdateContext {
 
         for (const auto index : removed)
         {
-            const IndexType offset = Dimensions * index;
+            const IndexType offset = Dimensions * featureTransformer.threat_row(index);
 
             for (IndexType j = 0; j < Dimensions; ++j)
                 toAcc[j] -= featureTransformer.threatWeights[offset + j];
@@ -466,7 +486,7 @@ struct AccumulatorUpdateContext {
 
         for (const auto index : added)
         {
-            const IndexType offset = Dimensions * index;
+            const IndexType offset = Dimensions * featureTransformer.threat_row(index);
 
             for (IndexType j = 0; j < Dimensions; ++j)
                 toAcc[j] += featureTransformer.threatWeights[offset + j];
@@ -489,12 +509,12 @@ auto make_accumulator_update_context(Color                                 persp
 }
 
 template<IndexType TransformedFeatureDimensions>
-void double_inc_update(Color                                                   perspective,
-                       const FeatureTransformer<TransformedFeatureDimensions>& featureTransformer,
-                       const Square                                            ksq,
-                       AccumulatorState<PSQFeatureSet>&                        middle_state,
-                       AccumulatorState<PSQFeatureSet>&                        target_state,
-                       const AccumulatorState<PSQFeatureSet>&                  computed) {
+int double_inc_update(Color                                                   perspective,
+                      const FeatureTransformer<TransformedFeatureDimensions>& featureTransformer,
+                      const Square                                            ksq,
+                      AccumulatorState<PSQFeatureSet>&                        middle_state,
+                      AccumulatorState<PSQFeatureSet>&                        target_state,
+                      const AccumulatorState<PSQFeatureSet>&                  computed) {
 
     assert(computed.acc<TransformedFeatureDimensions>().computed[perspective]);
     assert(!middle_state.acc<TransformedFeatureDimensions>().computed[perspective]);
@@ -530,16 +550,18 @@ void double_inc_update(Color                                                   p
     }
 
     target_state.acc<TransformedFeatureDimensions>().computed[perspective] = true;
+
+    return removed.ssize() + added.ssize();
 }
 
 template<IndexType TransformedFeatureDimensions>
-void double_inc_update(Color                                                   perspective,
-                       const FeatureTransformer<TransformedFeatureDimensions>& featureTransformer,
-                       const Square                                            ksq,
-                       AccumulatorState<ThreatFeatureSet>&                     middle_state,
-                       AccumulatorState<ThreatFeatureSet>&                     target_state,
-                       const AccumulatorState<ThreatFeatureSet>&               computed,
-                       const DirtyPiece&                                       dp2) {
+int double_inc_update(Color                                                   perspective,
+                      const FeatureTransformer<TransformedFeatureDimensions>& featureTransformer,
+                      const Square                                            ksq,
+                      AccumulatorState<ThreatFeatureSet>&                     middle_state,
+                      AccumulatorState<ThreatFeatureSet>&                     target_state,
+                      const AccumulatorState<ThreatFeatureSet>&               computed,
+                      const DirtyPiece&                                       dp2) {
 
     assert(computed.acc<TransformedFeatureDimensions>().computed[perspective]);
     assert(!middle_state.acc<TransformedFeatureDimensions>().computed[perspective]);
@@ -561,10 +583,12 @@ void double_inc_update(Color                                                   p
     updateContext.apply(added, removed);
 
     target_state.acc<TransformedFeatureDimensions>().computed[perspective] = true;
+
+    return removed.ssize() + added.ssize();
 }
 
 template<bool Forward, typename FeatureSet, IndexType TransformedFeatureDimensions>
-void update_accumulator_incremental(
+int update_accumulator_incremental(
   Color                                                   perspective,
   const FeatureTransformer<TransformedFeatureDimensions>& featureTransformer,
   const Square                                            ksq,
@@ -628,6 +652,8 @@ void update_accumulator_incremental(
     }
 
     (target_state.template acc<TransformedFeatureDimensions>()).computed[perspective] = true;
+
+    return removed.ssize() + added.ssize();
 }
 
 Bitboard get_changed_pieces(const std::array<Piece, SQUARE_NB>& oldPieces,
@@ -656,11 +682,11 @@ Bitboard get_changed_pieces(const std::array<Piece, SQUARE_NB>& oldPieces,
 }
 
 template<IndexType Dimensions>
-void update_accumulator_refresh_cache(Color                                 perspective,
-                                      const FeatureTransformer<Dimensions>& featureTransformer,
-                                      const Position&                       pos,
-                                      AccumulatorState<PSQFeatureSet>&      accumulatorState,
-                                      AccumulatorCaches::Cache<Dimensions>& cache) {
+int update_accumulator_refresh_cache(Color                                 perspective,
+                                     const FeatureTransformer<Dimensions>& featureTransformer,
+                                     const Position&                       pos,
+                                     AccumulatorState<PSQFeatureSet>&      accumulatorState,
+                                     AccumulatorCaches::Cache<Dimensions>& cache) {
 
     using Tiling [[maybe_unused]] = SIMDTiling<Dimensions, Dimensions, PSQTBuckets>;
 
@@ -807,13 +833,15 @@ void update_accumulator_refresh_cache(Color                                 pers
     accumulator.accumulation[perspective]     = entry.accumulation;
     accumulator.psqtAccumulation[perspective] = entry.psqtAccumulation;
 #endif
+
+    return removed.ssize() + added.ssize();
 }
 
 template<IndexType Dimensions>
-void update_threats_accumulator_full(Color                                 perspective,
-                                     const FeatureTransformer<Dimensions>& featureTransformer,
-                                     const Position&                       pos,
-                                     AccumulatorState<ThreatFeatureSet>&   accumulatorState) {
+int update_threats_accumulator_full(Color                                 perspective,
+                                    const FeatureTransformer<Dimensions>& featureTransformer,
+                                    const Position&                       pos,
+                                    AccumulatorState<ThreatFeatureSet>&   accumulatorState) {
     using Tiling [[maybe_unused]] = SIMDTiling<Dimensions, Dimensions, PSQTBuckets>;
 
     ThreatFeatureSet::IndexList active;
@@ -841,7 +869,7 @@ void update_threats_accumulator_full(Color                                 persp
         for (; i < active.ssize(); ++i)
         {
             size_t       index  = active[i];
-            const size_t offset = Dimensions * index;
+            const size_t offset = Dimensions * featureTransformer.threat_row(index);
             auto*        column = reinterpret_cast<const vec_i8_t*>(&threatWeights[offset]);
 
     #ifdef USE_NEON
@@ -895,7 +923,7 @@ void update_threats_accumulator_full(Color                                 persp
 
     for (const auto index : active)
     {
-        const IndexType offset = Dimensions * index;
+        const IndexType offset = Dimensions * featureTransformer.threat_row(index);
 
         for (IndexType j = 0; j < Dimensions; ++j)
             accumulator.accumulation[perspective][j] +=
@@ -907,8 +935,177 @@ void update_threats_accumulator_full(Color                                 persp
     }
 
 #endif
+
+    return active.ssize();
+}
+
+// Writes over a buffer larger than the L1 and L2 caches of current CPUs, so that
+// what the next update reads has to come from L3 or memory
+void evict_caches() {
+    static std::vector<std::uint8_t> buffer(4 * 1024 * 1024);
+
+    for (std::size_t i = 0; i < buffer.size(); i += CacheLineSize)
+        buffer[i]++;
+}
+
+// Times a region between two reads of the clock, in nanoseconds
+template<typename F>
+uint64_t time_region(F&& f) {
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    const auto end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
 }
 
 }
 
+// Mean time of timing an empty region, measured once. It is subtracted from each
+// timed update, as it is not negligible next to the shortest ones.
+uint64_t accumulator_timer_overhead() {
+    static const uint64_t overhead = [] {
+        constexpr int Samples = 100000;
+        uint64_t      total   = 0;
+
+        for (int i = 0; i < Samples; ++i)
+            total += time_region([] {});
+
+        return total / Samples;
+    }();
+
+    return overhead;
+}
+
+int accumulator_simd_width() {
+#ifdef VECTOR
+    return int(sizeof(vec_t)) * 8;
+#else
+    return 0;
+#endif
+}
+
+template<IndexType Dimensions>
+void AccumulatorStack::time_updates(const Position&                       pos,
+                                    const FeatureTransformer<Dimensions>& featureTransformer,
+                                    AccumulatorCaches::Cache<Dimensions>& cache,
+                                    AccumulatorTimings&                   timings) noexcept {
+
+    assert(size > 1);
+
+    const uint64_t overhead = accumulator_timer_overhead();
+
+    // Runs an update three times from the same inputs: as it comes, then again after
+    // 'restore', and once more after 'restore' and evicting the caches
+    auto time_update = [overhead](AccumulatorTiming& timing, bool& computed, auto&& update,
+                                  auto&& restore) {
+        uint64_t* const nanoseconds[] = {&timing.replayNanoseconds, &timing.warmNanoseconds,
+                                         &timing.coldNanoseconds};
+
+        for (int run = 0; run < 3; ++run)
+        {
+            if (run > 0)
+                restore();
+
+            if (run == 2)
+                evict_caches();
+
+            computed = false;
+
+            int            rows    = 0;
+            const uint64_t elapsed = time_region([&] { rows = update(); });
+
+            *nanoseconds[run] += elapsed > overhead ? elapsed - overhead : 0;
+
+            if (run == 0)
+                timing.rows += rows;
+        }
+
+        timing.updates++;
+    };
+
+    for (Color perspective : {WHITE, BLACK})
+    {
+        const Square ksq = pos.square<KING>(perspective);
+
+        auto&       psqLatest   = mut_latest<PSQFeatureSet>();
+        const auto& psqPrevious = accumulators<PSQFeatureSet>()[size - 2];
+        bool&       psqComputed = psqLatest.template acc<Dimensions>().computed[perspective];
+
+        if (!PSQFeatureSet::requires_refresh(psqLatest.diff, perspective))
+        {
+            time_update(
+              timings[PsqIncremental], psqComputed,
+              [&] {
+                  return update_accumulator_incremental<true>(perspective, featureTransformer,
+                                                              ksq, psqLatest, psqPrevious);
+              },
+              [] {});
+
+            PSQFeatureSet::IndexList removed, added;
+            PSQFeatureSet::append_changed_indices(perspective, ksq, psqLatest.diff, removed,
+                                                  added);
+
+            time_update(
+              timings[RowReduce], psqComputed,
+              [&] {
+                  fused_row_reduce<Vec16Wrapper, Dimensions, Add, Sub>(
+                    psqPrevious.template acc<Dimensions>().accumulation[perspective].data(),
+                    psqLatest.template acc<Dimensions>().accumulation[perspective].data(),
+                    &featureTransformer.weights[added[0] * Dimensions],
+                    &featureTransformer.weights[removed[0] * Dimensions]);
+                  return 2;
+              },
+              [] {});
+        }
+
+        // The refresh is timed last, it leaves the latest accumulator correct
+        auto&      entry = cache[ksq][perspective];
+        const auto saved = entry;
+
+        time_update(
+          timings[PsqRefresh], psqComputed,
+          [&] {
+              return update_accumulator_refresh_cache(perspective, featureTransformer, pos,
+                                                      psqLatest, cache);
+          },
+          [&] { entry = saved; });
+
+        if constexpr (Dimensions == TransformedFeatureDimensionsBig)
+        {
+            auto&       threatLatest   = mut_latest<ThreatFeatureSet>();
+            const auto& threatPrevious = accumulators<ThreatFeatureSet>()[size - 2];
+            bool& threatComputed = threatLatest.template acc<Dimensions>().computed[perspective];
+
+            if (!ThreatFeatureSet::requires_refresh(threatLatest.diff, perspective))
+                time_update(
+                  timings[ThreatIncremental], threatComputed,
+                  [&] {
+                      return update_accumulator_incremental<true>(
+                        perspective, featureTransformer, ksq, threatLatest, threatPrevious);
+                  },
+                  [] {});
+
+            time_update(
+              timings[ThreatRebuild], threatComputed,
+              [&] {
+                  return update_threats_accumulator_full(perspective, featureTransformer, pos,
+                                                         threatLatest);
+              },
+              [] {});
+        }
+    }
+}
+
+// Explicit template instantiations
+template void AccumulatorStack::time_updates<TransformedFeatureDimensionsBig>(
+  const Position&                                            pos,
+  const FeatureTransformer<TransformedFeatureDimensionsBig>& featureTransformer,
+  AccumulatorCaches::Cache<TransformedFeatureDimensionsBig>& cache,
+  AccumulatorTimings&                                        timings) noexcept;
+template void AccumulatorStack::time_updates<TransformedFeatureDimensionsSmall>(
+  const Position&                                              pos,
+  const FeatureTransformer<TransformedFeatureDimensionsSmall>& featureTransformer,
+  AccumulatorCaches::Cache<TransformedFeatureDimensionsSmall>& cache,
+  AccumulatorTimings&                                          timings) noexcept;
+
 }
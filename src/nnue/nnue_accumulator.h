@@ -149,6 +149,51 @@ struct AccumulatorState {
     }
 };
 
+// Counters of the accumulator updates made by an AccumulatorStack, by kind, and of
+// the weight rows they added or subtracted. Each perspective of each feature set
+// counts as a separate update. Only counted when built with NNUE_PROFILE.
+struct AccumulatorStats {
+    uint64_t updates = 0, forward = 0, backward = 0, refreshes = 0, threatRebuilds = 0;
+    uint64_t rows = 0, refreshRows = 0;
+
+    AccumulatorStats& operator+=(const AccumulatorStats& s) {
+        updates += s.updates;
+        forward += s.forward;
+        backward += s.backward;
+        refreshes += s.refreshes;
+        threatRebuilds += s.threatRebuilds;
+        rows += s.rows;
+        refreshRows += s.refreshRows;
+        return *this;
+    }
+};
+
+// The kinds of accumulator updates timed by the accumulator benchmark. RowReduce
+// is the fused add and subtract of two weight rows used by incremental updates.
+enum AccumulatorUpdateKind {
+    PsqIncremental,
+    PsqRefresh,
+    ThreatIncremental,
+    ThreatRebuild,
+    RowReduce,
+    UPDATE_KIND_NB
+};
+
+// Time taken by one kind of accumulator update with the caches as the replay left
+// them, when repeated right away, and when repeated after evicting the L1 and L2 caches
+struct AccumulatorTiming {
+    uint64_t updates = 0, rows = 0;
+    uint64_t replayNanoseconds = 0, warmNanoseconds = 0, coldNanoseconds = 0;
+};
+
+using AccumulatorTimings = std::array<AccumulatorTiming, UPDATE_KIND_NB>;
+
+// Width in bits of the vectors the accumulators are updated with, 0 without SIMD
+int accumulator_simd_width();
+
+// Time in nanoseconds that timing an update adds, already left out of the timings
+uint64_t accumulator_timer_overhead();
+
 class AccumulatorStack {
    public:
     static constexpr std::size_t MaxSize = MAX_PLY + 1;
@@ -165,6 +210,17 @@ class AccumulatorStack {
                   const FeatureTransformer<Dimensions>& featureTransformer,
                   AccumulatorCaches::Cache<Dimensions>& cache) noexcept;
 
+    // Times each kind of update of the latest accumulators from the previous ones,
+    // which must be computed, and leaves the latest ones computed
+    template<IndexType Dimensions>
+    void time_updates(const Position&                       pos,
+                      const FeatureTransformer<Dimensions>& featureTransformer,
+                      AccumulatorCaches::Cache<Dimensions>& cache,
+                      AccumulatorTimings&                   timings) noexcept;
+
+    [[nodiscard]] const AccumulatorStats& stats() const noexcept { return updateStats; }
+    void                                  reset_stats() noexcept { updateStats = {}; }
+
    private:
     template<typename T>
     [[nodiscard]] AccumulatorState<T>& mut_latest() noexcept;
@@ -199,6 +255,17 @@ class AccumulatorStack {
     std::array<AccumulatorState<PSQFeatureSet>, MaxSize>    psq_accumulators;
     std::array<AccumulatorState<ThreatFeatureSet>, MaxSize> threat_accumulators;
     std::size_t                                             size = 1;
+
+    // Counts an update of the given kind which touched `rows` weight rows
+    void count([[maybe_unused]] uint64_t AccumulatorStats::*kind,
+               [[maybe_unused]] int                         rows) noexcept {
+#if defined(NNUE_PROFILE)
+        ++(updateStats.*kind);
+        updateStats.rows += rows;
+#endif
+    }
+
+    AccumulatorStats updateStats;
 };
 
 }  // namespace Stockfish::Eval::NNUE
@@ -21,9 +21,12 @@
 #ifndef NNUE_ARCHITECTURE_H_INCLUDED
 #define NNUE_ARCHITECTURE_H_INCLUDED
 
+#include <cassert>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <iosfwd>
+#include <memory>
 
 #include "features/half_ka_v2_hm.h"
 #include "features/full_threats.h"
@@ -85,6 +88,13 @@ struct NetworkArchitecture {
         return hashValue;
     }
 
+    // Selects the kernels of the affine transforms, shared by all the networks whose
+    // layers have the same dimensions
+    static void select_kernels(const LayerKernels& kernels) {
+        decltype(fc_0)::select_kernel(kernels.sparse);
+        decltype(fc_1)::select_kernel(kernels.dense);
+    }
+
     // Read network parameters
     bool read_parameters(std::istream& stream) {
         return fc_0.read_parameters(stream) && ac_0.read_parameters(stream)
@@ -99,19 +109,26 @@ struct NetworkArchitecture {
             && fc_2.write_parameters(stream);
     }
 
-    std::int32_t propagate(const TransformedFeatureType* transformedFeatures) const {
-        struct alignas(CacheLineSize) Buffer {
-            alignas(CacheLineSize) typename decltype(fc_0)::OutputBuffer fc_0_out;
-            alignas(CacheLineSize) typename decltype(ac_sqr_0)::OutputType
-              ac_sqr_0_out[ceil_to_multiple<IndexType>(FC_0_OUTPUTS * 2, 32)];
-            alignas(CacheLineSize) typename decltype(ac_0)::OutputBuffer ac_0_out;
-            alignas(CacheLineSize) typename decltype(fc_1)::OutputBuffer fc_1_out;
-            alignas(CacheLineSize) typename decltype(ac_1)::OutputBuffer ac_1_out;
-            alignas(CacheLineSize) typename decltype(fc_2)::OutputBuffer fc_2_out;
+    // Maximum number of positions propagated together by propagate_batch()
+    static constexpr std::size_t MaxBatch = 16;
+
+    struct alignas(CacheLineSize) Buffer {
+        alignas(CacheLineSize) typename decltype(fc_0)::OutputBuffer fc_0_out;
+        alignas(CacheLineSize) typename decltype(ac_sqr_0)::OutputType
+          ac_sqr_0_out[ceil_to_multiple<IndexType>(FC_0_OUTPUTS * 2, 32)];
+        alignas(CacheLineSize) typename decltype(ac_0)::OutputBuffer ac_0_out;
+        alignas(CacheLineSize) typename decltype(fc_1)::OutputBuffer fc_1_out;
+        alignas(CacheLineSize) typename decltype(ac_1)::OutputBuffer ac_1_out;
+        alignas(CacheLineSize) typename decltype(fc_2)::OutputBuffer fc_2_out;
 
-            Buffer() { std::memset(this, 0, sizeof(*this)); }
-        };
+        Buffer() { std::memset(this, 0, sizeof(*this)); }
+    };
 
+    // Propagates the transformed features through the layers. With a profile, counts
+    // the nonzero input chunks and times each layer. The copy joining the two
+    // activations of fc_0 is counted with ac_0.
+    std::int32_t propagate(const TransformedFeatureType* transformedFeatures,
+                           [[maybe_unused]] NetworkProfile* profile = nullptr) const {
 #if defined(__clang__) && (__APPLE__)
         // workaround for a bug reported with xcode 12
         static thread_local auto tlsBuffer = std::make_unique<Buffer>();
@@ -121,22 +138,63 @@ struct NetworkArchitecture {
         alignas(CacheLineSize) static thread_local Buffer buffer;
 #endif
 
+#if defined(NNUE_PROFILE)
+        if (profile)
+        {
+            const auto input32 = reinterpret_cast<const std::int32_t*>(transformedFeatures);
+            for (IndexType i = 0; i < TransformedFeatureDimensions / 4; ++i)
+                profile->nnzChunks += input32[i] != 0;
+
+            profile->inputChunks += TransformedFeatureDimensions / 4;
+            ++profile->evals;
+        }
+#endif
+
+        ProfileTimer timer(profile);
+
         fc_0.propagate(transformedFeatures, buffer.fc_0_out);
+        timer.lap(Fc0);
         ac_sqr_0.propagate(buffer.fc_0_out, buffer.ac_sqr_0_out);
+        timer.lap(AcSqr0);
         ac_0.propagate(buffer.fc_0_out, buffer.ac_0_out);
         std::memcpy(buffer.ac_sqr_0_out + FC_0_OUTPUTS, buffer.ac_0_out,
                     FC_0_OUTPUTS * sizeof(typename decltype(ac_0)::OutputType));
+        timer.lap(Ac0);
         fc_1.propagate(buffer.ac_sqr_0_out, buffer.fc_1_out);
+        timer.lap(Fc1);
         ac_1.propagate(buffer.fc_1_out, buffer.ac_1_out);
+        timer.lap(Ac1);
         fc_2.propagate(buffer.ac_1_out, buffer.fc_2_out);
+        timer.lap(Fc2);
 
-        // buffer.fc_0_out[FC_0_OUTPUTS] is such that 1.0 is equal to 127*(1<<WeightScaleBits) in
-        // quantized form, but we want 1.0 to be equal to 600*OutputScale
-        std::int32_t fwdOut =
-          (buffer.fc_0_out[FC_0_OUTPUTS]) * (600 * OutputScale) / (127 * (1 << WeightScaleBits));
-        std::int32_t outputValue = buffer.fc_2_out[0] + fwdOut;
+        return output_value(buffer);
+    }
 
-        return outputValue;
+    // Number of positions going together through each affine layer in propagate_batch()
+    static constexpr IndexType TileSize = 2;
+
+    // Propagate up to MaxBatch transformed feature vectors, stored one after the other
+    // every `stride` elements. The inputs go through the affine layers TileSize at a
+    // time, so that each weight loaded into a register is used for all of them. The
+    // outputs are identical to those of propagate().
+    void propagate_batch(const TransformedFeatureType* transformedFeatures,
+                         std::size_t                   stride,
+                         std::size_t                   count,
+                         std::int32_t*                 output) const {
+
+        assert(count <= MaxBatch);
+
+        static thread_local auto tlsBuffers = std::make_unique<Buffer[]>(MaxBatch);
+        Buffer*                  buffers    = tlsBuffers.get();
+
+        std::size_t i = 0;
+
+        for (; i + TileSize <= count; i += TileSize)
+            propagate_tile<TileSize>(transformedFeatures + i * stride, stride, buffers + i,
+                                     output + i);
+
+        for (; i < count; ++i)
+            output[i] = propagate(transformedFeatures + i * stride);
     }
 
     std::size_t get_content_hash() const {
@@ -150,6 +208,59 @@ struct NetworkArchitecture {
         hash_combine(h, get_hash_value());
         return h;
     }
+
+   private:
+    template<IndexType Tile>
+    void propagate_tile(const TransformedFeatureType* transformedFeatures,
+                        std::size_t                   stride,
+                        Buffer*                       buffers,
+                        std::int32_t*                 output) const {
+
+        const std::uint8_t* in[Tile];
+        std::int32_t*       out[Tile];
+
+        for (IndexType b = 0; b < Tile; ++b)
+        {
+            in[b]  = transformedFeatures + b * stride;
+            out[b] = buffers[b].fc_0_out;
+        }
+
+        fc_0.template propagate_batch<Tile>(in, out);
+
+        for (IndexType b = 0; b < Tile; ++b)
+        {
+            ac_sqr_0.propagate(buffers[b].fc_0_out, buffers[b].ac_sqr_0_out);
+            ac_0.propagate(buffers[b].fc_0_out, buffers[b].ac_0_out);
+            std::memcpy(buffers[b].ac_sqr_0_out + FC_0_OUTPUTS, buffers[b].ac_0_out,
+                        FC_0_OUTPUTS * sizeof(typename decltype(ac_0)::OutputType));
+            in[b]  = buffers[b].ac_sqr_0_out;
+            out[b] = buffers[b].fc_1_out;
+        }
+
+        fc_1.template propagate_batch<Tile>(in, out);
+
+        for (IndexType b = 0; b < Tile; ++b)
+        {
+            ac_1.propagate(buffers[b].fc_1_out, buffers[b].ac_1_out);
+            in[b]  = buffers[b].ac_1_out;
+            out[b] = buffers[b].fc_2_out;
+        }
+
+        fc_2.template propagate_batch<Tile>(in, out);
+
+        for (IndexType b = 0; b < Tile; ++b)
+            output[b] = output_value(buffers[b]);
+    }
+
+    static std::int32_t output_value(const Buffer& buffer) {
+        // buffer.fc_0_out[FC_0_OUTPUTS] is such that 1.0 is equal to 127*(1<<WeightScaleBits) in
+        // quantized form, but we want 1.0 to be equal to 600*OutputScale
+        std::int32_t fwdOut =
+          (buffer.fc_0_out[FC_0_OUTPUTS]) * (600 * OutputScale) / (127 * (1 << WeightScaleBits));
+        std::int32_t outputValue = buffer.fc_2_out[0] + fwdOut;
+
+        return outputValue;
+    }
 };
 
 }  // namespace Stockfish::Eval::NNUE
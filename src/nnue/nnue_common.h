@@ -22,7 +22,9 @@
 #define NNUE_COMMON_H_INCLUDED
 
 #include <algorithm>
+#include <array>
 #include <cassert>
+#include <chrono>
 #include <cstdint>
 #include <cstring>
 #include <iostream>
@@ -46,6 +48,15 @@
     #include <arm_neon.h>
 #endif
 
+#if defined(NNUE_PROFILE) && (defined(__x86_64__) || defined(__i386__) || defined(_M_X64))
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #else
+        #include <x86intrin.h>
+    #endif
+    #define NNUE_PROFILE_TSC
+#endif
+
 namespace Stockfish::Eval::NNUE {
 
 using BiasType         = std::int16_t;
@@ -57,6 +68,10 @@ using IndexType        = std::uint32_t;
 // Version of the evaluation file
 constexpr std::uint32_t Version = 0x7AF32F20u;
 
+// Version of an evaluation file whose threat weight rows are stored once each,
+// with a table of the row of every threat feature
+constexpr std::uint32_t CompressedVersion = 0x7AF32F21u;
+
 // Constant used in evaluation value calculation
 constexpr int OutputScale     = 16;
 constexpr int WeightScaleBits = 6;
@@ -89,6 +104,117 @@ constexpr IntType ceil_to_multiple(IntType n, IntType base) {
     return (n + base - 1) / base * base;
 }
 
+// The affine transforms have several kernels, which give the same results but do not
+// perform the same depending on the latencies, ports and caches of the CPU. The one
+// run by each layer is selected once, and the fastest can be measured at runtime.
+enum class SparseKernel : std::uint8_t {
+    OneChain,     // All the nonzero input chunks accumulated in one register set
+    TwoChains,    // Consecutive nonzero chunks spread over two register sets
+    ThreeChains,  // ... over three register sets
+    BitScan       // Nonzero chunks found by a bit scan while accumulating, with no index list
+};
+
+enum class DenseKernel : std::uint8_t {
+    OneChain,    // All the input chunks accumulated in one register set
+    TwoChains,   // Consecutive input chunks spread over two register sets
+    HalfOutputs  // Two passes over the input, each one for half of the outputs
+};
+
+struct LayerKernels {
+    SparseKernel sparse;  // In AffineTransformSparseInput
+    DenseKernel  dense;   // In AffineTransform, for the hidden layer
+};
+
+constexpr const char* SparseKernelNames[] = {"one chain", "two chains", "three chains",
+                                             "bit scan"};
+constexpr const char* DenseKernelNames[]  = {"one chain", "two chains", "half outputs"};
+
+#if defined(USE_VNNI)
+constexpr LayerKernels DefaultKernels = {SparseKernel::ThreeChains, DenseKernel::OneChain};
+#else
+constexpr LayerKernels DefaultKernels = {SparseKernel::OneChain, DenseKernel::OneChain};
+#endif
+
+// The stages of an evaluation timed when built with NNUE_PROFILE
+enum ProfileStage {
+    FeatureTransform,
+    Fc0,
+    AcSqr0,
+    Ac0,
+    Fc1,
+    Ac1,
+    Fc2,
+    PROFILE_STAGE_NB
+};
+
+// Time spent by one net in each stage, and the number of nonzero 32-bit chunks in
+// the input of its first layer, which are the ones find_nnz() hands to the sparse
+// affine transform. Only gathered when built with NNUE_PROFILE.
+struct NetworkProfile {
+    uint64_t                                evals = 0, nnzChunks = 0, inputChunks = 0;
+    std::array<uint64_t, PROFILE_STAGE_NB> ticks{};
+
+    NetworkProfile& operator+=(const NetworkProfile& p) {
+        evals += p.evals;
+        nnzChunks += p.nnzChunks;
+        inputChunks += p.inputChunks;
+        for (int i = 0; i < PROFILE_STAGE_NB; ++i)
+            ticks[i] += p.ticks[i];
+        return *this;
+    }
+};
+
+struct EvalProfile {
+    NetworkProfile big, small;
+
+    EvalProfile& operator+=(const EvalProfile& p) {
+        big += p.big;
+        small += p.small;
+        return *this;
+    }
+};
+
+#if defined(NNUE_PROFILE)
+// Time stamp counter cycles on x86, nanoseconds elsewhere
+inline uint64_t profile_ticks() {
+    #if defined(NNUE_PROFILE_TSC)
+    return __rdtsc();
+    #else
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch())
+                      .count());
+    #endif
+}
+#endif
+
+// Adds the time of each stage of an evaluation to a profile, when given one. Without
+// NNUE_PROFILE it does nothing, and the calls to it compile away.
+class ProfileTimer {
+   public:
+#if defined(NNUE_PROFILE)
+    explicit ProfileTimer(NetworkProfile* p) :
+        profile(p),
+        start(p ? profile_ticks() : 0) {}
+
+    void lap(ProfileStage stage) {
+        if (profile)
+        {
+            const uint64_t end = profile_ticks();
+            profile->ticks[stage] += end - start;
+            start = end;
+        }
+    }
+
+   private:
+    NetworkProfile* profile;
+    uint64_t        start;
+#else
+    explicit ProfileTimer(NetworkProfile*) {}
+
+    void lap(ProfileStage) {}
+#endif
+};
+
 
 // Utility to read an integer (signed or unsigned, any size)
 // from a stream in little-endian order. We swap the byte order after the read if
@@ -22,10 +22,14 @@
 #define NNUE_FEATURE_TRANSFORMER_H_INCLUDED
 
 #include <algorithm>
+#include <cassert>
 #include <cstdint>
 #include <cstring>
 #include <iosfwd>
 #include <iterator>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 #include "../position.h"
 #include "../types.h"
@@ -48,18 +52,17 @@ invert_permutation(const std::array<std::size_t, Len>& order) {
 
 // Divide a byte region of size TotalSize to chunks of size
 // BlockSize, and permute the blocks by a given order
-template<std::size_t BlockSize, typename T, std::size_t N, std::size_t OrderSize>
-void permute(std::array<T, N>& data, const std::array<std::size_t, OrderSize>& order) {
-    constexpr std::size_t TotalSize = N * sizeof(T);
-
-    static_assert(TotalSize % (BlockSize * OrderSize) == 0,
-                  "ChunkSize * OrderSize must perfectly divide TotalSize");
+template<std::size_t BlockSize, typename T, std::size_t OrderSize>
+void permute(T* data, std::size_t count, const std::array<std::size_t, OrderSize>& order) {
+    const std::size_t TotalSize = count * sizeof(T);
 
     constexpr std::size_t ProcessChunkSize = BlockSize * OrderSize;
 
+    assert(TotalSize % ProcessChunkSize == 0);
+
     std::array<std::byte, ProcessChunkSize> buffer{};
 
-    std::byte* const bytes = reinterpret_cast<std::byte*>(data.data());
+    std::byte* const bytes = reinterpret_cast<std::byte*>(data);
 
     for (std::size_t i = 0; i < TotalSize; i += ProcessChunkSize)
     {
@@ -77,6 +80,14 @@ void permute(std::array<T, N>& data, const std::array<std::size_t, OrderSize>& o
     }
 }
 
+template<std::size_t BlockSize, typename T, std::size_t N, std::size_t OrderSize>
+void permute(std::array<T, N>& data, const std::array<std::size_t, OrderSize>& order) {
+    static_assert(N * sizeof(T) % (BlockSize * OrderSize) == 0,
+                  "ChunkSize * OrderSize must perfectly divide TotalSize");
+
+    permute<BlockSize>(data.data(), N, order);
+}
+
 // Input feature converter
 template<IndexType TransformedFeatureDimensions>
 class FeatureTransformer {
@@ -133,7 +144,7 @@ class FeatureTransformer {
         permute<16>(weights, PackusEpi16Order);
 
         if (UseThreats)
-            permute<8>(threatWeights, PackusEpi16Order);
+            permute<8>(threatWeights.data(), threatRowCount * HalfDimensions, PackusEpi16Order);
     }
 
     void unpermute_weights() {
@@ -141,7 +152,8 @@ class FeatureTransformer {
         permute<16>(weights, InversePackusEpi16Order);
 
         if (UseThreats)
-            permute<8>(threatWeights, InversePackusEpi16Order);
+            permute<8>(threatWeights.data(), threatRowCount * HalfDimensions,
+                       InversePackusEpi16Order);
     }
 
     inline void scale_weights(bool read) {
@@ -156,16 +168,107 @@ class FeatureTransformer {
             biases[i] = read ? biases[i] * 2 : biases[i] / 2;
     }
 
+    // Stores each distinct threat weight row once, at the start of threatWeights,
+    // followed by the row of each threat feature. Many threat features never occur
+    // in training and keep identical rows, so that fewer rows compete for the caches.
+    // Returns false, keeping one row per feature, if the row table would not fit.
+    bool share_threat_rows() {
+        if (threatRowCount < ThreatInputDimensions)
+            return true;
+
+        std::vector<IndexType>                          rows(ThreatInputDimensions);
+        std::unordered_multimap<std::size_t, IndexType> rowsByHash;
+        IndexType                                       count = 0;
+
+        // A row moves only towards the start, to a slot whose row was moved already
+        for (IndexType i = 0; i < ThreatInputDimensions; ++i)
+        {
+            const ThreatWeightType* row  = &threatWeights[i * HalfDimensions];
+            const std::size_t       hash = std::hash<std::string_view>{}(
+              std::string_view(reinterpret_cast<const char*>(row), HalfDimensions));
+
+            auto [first, last] = rowsByHash.equal_range(hash);
+            auto same          = std::find_if(first, last, [&](const auto& entry) {
+                return std::memcmp(&threatWeights[entry.second * HalfDimensions], row,
+                                   HalfDimensions)
+                    == 0;
+            });
+
+            if (same != last)
+                rows[i] = same->second;
+            else
+            {
+                rows[i] = count++;
+                rowsByHash.emplace(hash, rows[i]);
+
+                if (rows[i] != i)
+                    std::copy(row, row + HalfDimensions, &threatWeights[rows[i] * HalfDimensions]);
+            }
+        }
+
+        threatRowCount = count;
+
+        if (!fits_threat_rows(threatRowCount))
+        {
+            expand_threat_rows(rows.data());
+            return false;
+        }
+
+        std::memcpy(&threatWeights[threatRowCount * HalfDimensions], rows.data(),
+                    ThreatInputDimensions * sizeof(IndexType));
+        return true;
+    }
+
+    // Gives each threat feature its own row again, in feature order
+    void expand_threat_rows() {
+        if (threatRowCount == ThreatInputDimensions)
+            return;
+
+        std::vector<IndexType> rows(ThreatInputDimensions);
+        std::memcpy(rows.data(), &threatWeights[threatRowCount * HalfDimensions],
+                    ThreatInputDimensions * sizeof(IndexType));
+        expand_threat_rows(rows.data());
+    }
+
+    // Read network parameters
     // Read network parameters
     // TODO: This is ugly. Currently LEB128 on the entire L1 necessitates
     // reading the weights into a combined array, and then splitting.
-    bool read_parameters(std::istream& stream) {
+    bool read_parameters(std::istream& stream, bool compressedThreats = false) {
         read_leb_128<BiasType>(stream, biases);
 
         if (UseThreats)
         {
-            read_little_endian<ThreatWeightType>(stream, threatWeights.data(),
-                                                 ThreatInputDimensions * HalfDimensions);
+            if (compressedThreats)
+            {
+                // Only the distinct rows and the row table are written, the rest of
+                // threatWeights is left untouched
+                const std::uint32_t rowCount = read_little_endian<std::uint32_t>(stream);
+
+                if (rowCount >= ThreatInputDimensions || !fits_threat_rows(rowCount))
+                    return false;
+
+                threatRowCount = rowCount;
+                read_little_endian<ThreatWeightType>(stream, threatWeights.data(),
+                                                     threatRowCount * HalfDimensions);
+
+                std::vector<IndexType> rows(ThreatInputDimensions);
+                read_little_endian<IndexType>(stream, rows.data(), ThreatInputDimensions);
+
+                if (std::any_of(rows.begin(), rows.end(),
+                                [&](IndexType row) { return row >= threatRowCount; }))
+                    return false;
+
+                std::memcpy(&threatWeights[threatRowCount * HalfDimensions], rows.data(),
+                            ThreatInputDimensions * sizeof(IndexType));
+            }
+            else
+            {
+                threatRowCount = ThreatInputDimensions;
+                read_little_endian<ThreatWeightType>(stream, threatWeights.data(),
+                                                     ThreatInputDimensions * HalfDimensions);
+            }
+
             read_leb_128<WeightType>(stream, weights);
 
             auto combinedPsqtWeights =
@@ -197,7 +300,7 @@ class FeatureTransformer {
     }
 
     // Write network parameters
-    bool write_parameters(std::ostream& stream) const {
+    bool write_parameters(std::ostream& stream, bool compressedThreats = false) const {
         std::unique_ptr<FeatureTransformer> copy = std::make_unique<FeatureTransformer>(*this);
 
         copy->unpermute_weights();
@@ -209,8 +312,25 @@ class FeatureTransformer {
 
         if (UseThreats)
         {
-            write_little_endian<ThreatWeightType>(stream, copy->threatWeights.data(),
-                                                  ThreatInputDimensions * HalfDimensions);
+            if (compressedThreats)
+            {
+                if (!copy->share_threat_rows())
+                    return false;
+
+                write_little_endian<std::uint32_t>(stream, copy->threatRowCount);
+                write_little_endian<ThreatWeightType>(stream, copy->threatWeights.data(),
+                                                      copy->threatRowCount * HalfDimensions);
+
+                for (IndexType i = 0; i < ThreatInputDimensions; ++i)
+                    write_little_endian<IndexType>(stream, copy->threat_row(i));
+            }
+            else
+            {
+                copy->expand_threat_rows();
+                write_little_endian<ThreatWeightType>(stream, copy->threatWeights.data(),
+                                                      ThreatInputDimensions * HalfDimensions);
+            }
+
             write_leb_128<WeightType>(stream, copy->weights);
 
             auto combinedPsqtWeights =
@@ -437,6 +557,44 @@ class FeatureTransformer {
     alignas(CacheLineSize)
       std::array<PSQTWeightType,
                  UseThreats ? ThreatInputDimensions * PSQTBuckets : 0> threatPsqtWeights;
+
+    // Number of rows of threatWeights in use. With fewer rows than threat features,
+    // features with identical weights share a row, and the row of each feature is
+    // stored in threatWeights right after the rows in use.
+    IndexType threatRowCount = 0;
+
+    // Row of threatWeights of a threat feature. The table is looked up only when rows
+    // are shared, a regular net keeps one row per feature in feature order.
+    IndexType threat_row(IndexType index) const {
+        if (threatRowCount == ThreatInputDimensions)
+            return index;
+
+        IndexType row;
+        std::memcpy(&row,
+                    &threatWeights[threatRowCount * HalfDimensions + index * sizeof(IndexType)],
+                    sizeof(IndexType));
+        return row;
+    }
+
+   private:
+    // Whether rowCount shared rows leave room for the row table in threatWeights
+    static constexpr bool fits_threat_rows(std::size_t rowCount) {
+        return rowCount * HalfDimensions + ThreatInputDimensions * sizeof(IndexType)
+            <= std::size_t(ThreatInputDimensions) * HalfDimensions;
+    }
+
+    // Copies the rows back to one per feature, in place. Each row was stored at the
+    // latest at the slot of the first feature using it, so that going backwards no
+    // slot is overwritten while a feature still needs it.
+    void expand_threat_rows(const IndexType* rows) {
+        for (IndexType i = ThreatInputDimensions; i-- > 0;)
+            if (rows[i] != i)
+                std::copy(&threatWeights[rows[i] * HalfDimensions],
+                          &threatWeights[rows[i] * HalfDimensions] + HalfDimensions,
+                          &threatWeights[i * HalfDimensions]);
+
+        threatRowCount = ThreatInputDimensions;
+    }
 };
 
 }  // namespace Stockfish::Eval::NNUE
@@ -296,6 +296,85 @@ Position& Position::set(const string& fenStr, bool isChess960, StateInfo* si) {
 }
 
 
+// Tells whether set() can be trusted with a FEN string from untrusted input, and
+// the position it describes searched: eight full ranks, one king and at most 16
+// pieces per side, no pawns on the first or last rank, castling rights with a
+// rook to castle with on the back rank of the king, and the side not to move
+// not in check. Unlike set(), it rejects whatever it does not understand.
+bool Position::is_valid_fen(const std::string& fen) {
+
+    std::istringstream ss(fen);
+    std::string        board, color, castling;
+    int                rank = 7, file = 0, count[COLOR_NB] = {}, kings[COLOR_NB] = {};
+    Piece              squares[SQUARE_NB] = {};
+
+    if (!(ss >> board >> color) || (color != "w" && color != "b"))
+        return false;
+
+    for (char token : board)
+    {
+        size_t idx;
+
+        if (token == '/')
+        {
+            if (file != 8 || rank-- == 0)
+                return false;
+            file = 0;
+        }
+        else if (token >= '1' && token <= '8' && file + token - '0' <= 8)
+            file += token - '0';
+
+        else if (file < 8 && (idx = PieceToChar.find(token)) != string::npos)
+        {
+            const Piece pc = Piece(idx);
+
+            if (type_of(pc) == PAWN && (rank == 0 || rank == 7))
+                return false;
+
+            ++count[color_of(pc)];
+            kings[color_of(pc)] += type_of(pc) == KING;
+            squares[make_square(File(file++), Rank(rank))] = pc;
+        }
+        else
+            return false;
+    }
+
+    if (rank != 0 || file != 8 || kings[WHITE] != 1 || kings[BLACK] != 1 || count[WHITE] > 16
+        || count[BLACK] > 16)
+        return false;
+
+    if (ss >> castling && castling != "-")
+        for (char token : castling)
+        {
+            const Color c    = islower(token) ? BLACK : WHITE;
+            const Piece rook = make_piece(c, ROOK);
+            const Rank  r    = relative_rank(c, RANK_1);
+            const auto  ksq  = std::find(squares, squares + SQUARE_NB, make_piece(c, KING));
+            const File  kf   = file_of(Square(ksq - squares));
+
+            token = char(toupper(token));
+
+            if (rank_of(Square(ksq - squares)) != r)
+                return false;
+
+            bool found = false;
+            for (File f = FILE_A; f <= FILE_H; ++f)
+                found |= squares[make_square(f, r)] == rook
+                      && (token == 'K' ? f > kf : token == 'Q' ? f < kf : f == token - 'A');
+
+            if (!found)
+                return false;
+        }
+
+    StateInfo st;
+    Position  pos;
+    pos.set(fen, false, &st);
+
+    const Color us = pos.side_to_move();
+    return !(pos.attackers_to(pos.square<KING>(~us)) & pos.pieces(us));
+}
+
+
 // Helper function used to set castling
 // rights given the corresponding color and the rook starting square.
 void Position::set_castling_right(Color c, Square rfrom) {
@@ -169,7 +169,8 @@ class Position {
     Value non_pawn_material() const;
 
     // Position consistency check, for debugging
-    bool pos_is_ok() const;
+    bool        pos_is_ok() const;
+    static bool is_valid_fen(const std::string& fen);
     bool material_key_is_ok() const;
     void flip();
 
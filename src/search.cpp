@@ -182,6 +182,9 @@ void Search::Worker::ensure_network_replicated() {
 void Search::Worker::start_searching() {
 
     accumulatorStack.reset();
+    TranspositionTable::collect_stats(&ttStats);
+    Eval::NNUE::collect_profile(&nnueProfile);
+    Tablebases::collect_cache_stats(&tbCacheStats);
 
     // Non-main threads go directly to iterative_deepening()
     if (!is_mainthread())
@@ -252,6 +255,93 @@ void Search::Worker::start_searching() {
     main_manager()->updates.onBestmove(bestmove, ponder);
 }
 
+// Searches a position independently of the other threads, which may be busy
+// with positions of their own, and reports the best line found. This is
+// used for batch analysis, see ThreadPool::analyse(). There is no main
+// thread to enforce time limits, so only the depth and nodes limits are
+// obeyed, the latter only at the end of an iteration.
+void Search::Worker::analyse(size_t             id,
+                             const std::string& fen,
+                             const LimitsType&  searchLimits,
+                             const UpdateBatch& onResult) {
+
+    standalone       = true;
+    nodeBudgetSpent  = false;
+    limits           = searchLimits;
+    limits.startTime = now();
+    nodes = tbHits = bestMoveChanges = 0;
+    nmpMinPly                        = 0;
+    rootDepth = completedDepth = 0;
+
+    rootPos.set(fen, options["UCI_Chess960"], &rootState);
+
+    rootMoves.clear();
+    for (const auto& m : MoveList<LEGAL>(rootPos))
+        rootMoves.emplace_back(m);
+
+    tbConfig = Tablebases::rank_root_moves(options, rootPos, rootMoves);
+
+    accumulatorStack.reset();
+    TranspositionTable::collect_stats(&ttStats);
+    Eval::NNUE::collect_profile(&nnueProfile);
+    Tablebases::collect_cache_stats(&tbCacheStats);
+
+    // Each position is a search of its own, the entries of the previous ones age
+    tt.new_search();
+
+    if (!rootMoves.empty())
+        iterative_deepening();
+
+    standalone = nodeBudgetSpent = false;
+
+    BatchResult result;
+    std::string bestmove = "(none)", pv;
+    InfoFull&   info     = result.info;
+    TimePoint   time     = std::max(TimePoint(1), now() - limits.startTime);
+
+    info.depth    = completedDepth;
+    info.selDepth = 0;
+    info.multiPV  = 1;
+    info.score    = {rootPos.checkers() ? -VALUE_MATE : VALUE_DRAW, rootPos};
+
+    if (!rootMoves.empty())
+    {
+        const RootMove& rm      = rootMoves[0];
+        bool            updated = rm.score != -VALUE_INFINITE;
+        Value           v       = updated ? rm.uciScore : rm.previousScore;
+
+        if (v == -VALUE_INFINITE)
+            v = VALUE_ZERO;
+
+        if (tbConfig.rootInTB && std::abs(v) <= VALUE_TB)
+            v = rm.tbScore;
+
+        for (Move m : rm.pv)
+            pv += UCIEngine::move(m, rootPos.is_chess960()) + " ";
+
+        if (!pv.empty())
+            pv.pop_back();
+
+        bestmove      = UCIEngine::move(rm.pv[0], rootPos.is_chess960());
+        info.selDepth = rm.selDepth;
+        info.score    = {v, rootPos};
+        info.bound    = rm.scoreLowerbound ? "lowerbound" : rm.scoreUpperbound ? "upperbound" : "";
+    }
+
+    info.timeMs   = time;
+    info.nodes    = nodes;
+    info.nps      = nodes * 1000 / time;
+    info.tbHits   = tbHits + (tbConfig.rootInTB ? rootMoves.size() : 0);
+    info.pv       = pv;
+    info.hashfull = tt.hashfull();
+
+    result.id       = id;
+    result.fen      = fen;
+    result.bestmove = bestmove;
+    onResult(result);
+}
+
+
 // Main iterative deepening loop. It calls search()
 // repeatedly with increasing depth until the allocated thinking time has been
 // consumed, the user stops the search, or the maximum search depth is reached.
@@ -308,13 +398,16 @@ void Search::Worker::iterative_deepening() {
 
     multiPV = std::min(multiPV, rootMoves.size());
 
+    // The root moves are only shared out for a single PV, whose search visits each once per depth
+    rootSplit = options["RootSplit"] && threads.size() > 1 && multiPV == 1 && !standalone;
+
     int searchAgainCounter = 0;
 
     lowPlyHistory.fill(97);
 
     // Iterative deepening loop until requested to stop or the target depth is reached
-    while (++rootDepth < MAX_PLY && !threads.stop
-           && !(limits.depth && mainThread && rootDepth > limits.depth))
+    while (++rootDepth < MAX_PLY && !stopped()
+           && !(limits.depth && (mainThread || standalone) && rootDepth > limits.depth))
     {
         // Age out PV variability metric
         if (mainThread)
@@ -379,7 +472,7 @@ void Search::Worker::iterative_deepening() {
                 // If search has been stopped, we break immediately. Sorting is
                 // safe because RootMoves is still valid, although it refers to
                 // the previous iteration.
-                if (threads.stop)
+                if (stopped())
                     break;
 
                 // When failing high/low give some update before a re-search. To avoid
@@ -427,11 +520,11 @@ void Search::Worker::iterative_deepening() {
                 && !(threads.abortedSearch && is_loss(rootMoves[0].uciScore)))
                 main_manager()->pv(*this, threads, tt, rootDepth);
 
-            if (threads.stop)
+            if (stopped())
                 break;
         }
 
-        if (!threads.stop)
+        if (!stopped())
             completedDepth = rootDepth;
 
         // We make sure not to pick an unproven mated-in score,
@@ -577,7 +670,7 @@ void Search::Worker::undo_null_move(Position& pos) { pos.undo_null_move(); }
 
 
 // Reset histories, usually before a new game
-void Search::Worker::clear() {
+void Search::Worker::clear(bool keepRefreshTable) {
     mainHistory.fill(68);
     captureHistory.fill(-689);
     pawnHistory.fill(-1238);
@@ -604,7 +697,13 @@ void Search::Worker::clear() {
     for (size_t i = 1; i < reductions.size(); ++i)
         reductions[i] = int(2747 / 128.0 * std::log(i));
 
-    refreshTable.clear(networks[numaAccessToken]);
+    if (!keepRefreshTable)
+        refreshTable.clear(networks[numaAccessToken]);
+    accumulatorStack.reset_stats();
+
+    ttStats      = TTStats();
+    nnueProfile  = Eval::NNUE::EvalProfile();
+    tbCacheStats = Tablebases::ProbeCacheStats();
 }
 
 
@@ -663,6 +762,8 @@ Value Search::Worker::search(
     // Check for the available remaining time
     if (is_mainthread())
         main_manager()->check_time(*this);
+    else if (standalone)
+        check_node_budget();
 
     // Used to send selDepth info to GUI (selDepth counts from 1, ply from 0)
     if (PvNode && selDepth < ss->ply + 1)
@@ -671,8 +772,7 @@ Value Search::Worker::search(
     if (!rootNode)
     {
         // Step 2. Check for aborted search and immediate draw
-        if (threads.stop.load(std::memory_order_relaxed) || pos.is_draw(ss->ply)
-            || ss->ply >= MAX_PLY)
+        if (stopped() || pos.is_draw(ss->ply) || ss->ply >= MAX_PLY)
             return (ss->ply >= MAX_PLY && !ss->inCheck) ? evaluate(pos) : value_draw(nodes);
 
         // Step 3. Mate distance pruning. Even if we mate at the next move our score
@@ -700,6 +800,10 @@ Value Search::Worker::search(
     excludedMove                   = ss->excludedMove;
     posKey                         = pos.key();
     auto [ttHit, ttData, ttWriter] = tt.probe(posKey);
+#if defined(TT_STATS)
+    if (tt.numa_placed())
+        count_tt_probe(posKey);
+#endif
     // Need further processing of the saved data
     ss->ttHit    = ttHit;
     ttData.move  = rootNode ? rootMoves[pvIdx].pv[0] : ttHit ? ttData.move : Move::none();
@@ -1017,6 +1121,17 @@ moves_loop:  // When in check, search starts here
         if (rootNode && !std::count(rootMoves.begin() + pvIdx, rootMoves.begin() + pvLast, move))
             continue;
 
+        // In a split search, helper threads skip the root moves but the first that
+        // another helper has already taken at this depth, and the main thread skips
+        // those that a helper has found to fail low against its alpha.
+        if (rootNode && rootSplit && moveCount
+            && (is_mainthread() ? threads.rootClaims.refuted(move, depth, alpha)
+                                : !threads.rootClaims.claim(move, depth, threadIdx)))
+        {
+            std::find(rootMoves.begin(), rootMoves.end(), move)->score = -VALUE_INFINITE;
+            continue;
+        }
+
         ss->moveCount = ++moveCount;
 
         if (rootNode && is_mainthread() && nodes > 10000000)
@@ -1292,7 +1407,7 @@ moves_loop:  // When in check, search starts here
         // Finished searching the move. If a stop occurred, the return value of
         // the search cannot be trusted, and we return immediately without updating
         // best move, principal variation nor transposition table.
-        if (threads.stop.load(std::memory_order_relaxed))
+        if (stopped())
             return VALUE_ZERO;
 
         if (rootNode)
@@ -1301,6 +1416,9 @@ moves_loop:  // When in check, search starts here
 
             rm.effort += nodes - nodeCount;
 
+            if (rootSplit && !is_mainthread() && moveCount > 1 && value <= alpha)
+                threads.rootClaims.refute(move, depth, value);
+
             rm.averageScore =
               rm.averageScore != -VALUE_INFINITE ? (value + rm.averageScore) / 2 : value;
 
@@ -1536,6 +1654,10 @@ Value Search::Worker::qsearch(Position& pos, Stack* ss, Value alpha, Value beta)
     // Step 3. Transposition table lookup
     posKey                         = pos.key();
     auto [ttHit, ttData, ttWriter] = tt.probe(posKey);
+#if defined(TT_STATS)
+    if (tt.numa_placed())
+        count_tt_probe(posKey);
+#endif
     // Need further processing of the saved data
     ss->ttHit    = ttHit;
     ttData.move  = ttHit ? ttData.move : Move::none();
@@ -1750,6 +1872,15 @@ Value Search::Worker::evaluate(const Position& pos) {
                           optimism[pos.side_to_move()]);
 }
 
+// Tells whether a TT probe went to the memory of the NUMA node this thread runs on,
+// reported after the search by the thread allocation info.
+// Only called with TT_STATS, to keep the node loop of other builds unchanged.
+void Search::Worker::count_tt_probe(Key key) {
+    auto& counter =
+      tt.numa_node_of(key) == numaAccessToken.get_numa_index() ? ttLocalProbes : ttRemoteProbes;
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
 namespace {
 // Adjusts a mate or TB score from "plies to mate from the root" to
 // "plies to mate from the current position". Standard scores are unchanged.
@@ -1967,6 +2098,18 @@ void SearchManager::check_time(Search::Worker& worker) {
         worker.threads.stop = worker.threads.abortedSearch = true;
 }
 
+bool Search::Worker::stopped() const {
+    return threads.stop.load(std::memory_order_relaxed) || nodeBudgetSpent;
+}
+
+// Without a main thread to stop it, a standalone search stops itself once its node
+// budget is spent, checked at each node as check_time() does for the main thread.
+void Search::Worker::check_node_budget() {
+    if (limits.nodes && completedDepth >= 1
+        && nodes.load(std::memory_order_relaxed) >= limits.nodes)
+        nodeBudgetSpent = true;
+}
+
 // Used to correct and extend PVs for moves that have a TB (but not a mate) score.
 // Keeps the search based PV for as long as it is verified to maintain the game
 // outcome, truncates afterwards. Finally, extends to mate the PV, providing a
@@ -41,6 +41,7 @@
 #include "score.h"
 #include "syzygy/tbprobe.h"
 #include "timeman.h"
+#include "tt.h"
 #include "types.h"
 
 namespace Stockfish {
@@ -52,7 +53,6 @@ enum NodeType {
     Root
 };
 
-class TranspositionTable;
 class ThreadPool;
 class OptionsMap;
 
@@ -154,6 +154,54 @@ struct SharedState {
 
 class Worker;
 
+// The root moves taken by the helper threads of a split search at each depth, and
+// those they refuted, shared by the thread pool. Helpers leave the moves that
+// another helper has started at the same or a larger depth, see Worker::search(),
+// so that they spread over the root moves instead of all following the main
+// thread, which skips the moves already refuted. Lock-free, a move is taken with
+// a compare and swap of its depth and thread.
+class RootMoveClaims {
+   public:
+    void clear() {
+        for (auto& c : claims)
+            c.store(0, std::memory_order_relaxed);
+        for (auto& r : refutations)
+            r.store(0, std::memory_order_relaxed);
+    }
+
+    // Whether the helper may search the move at this depth, taking it if nobody did
+    bool claim(Move m, Depth depth, size_t threadIdx) {
+        auto&    c    = claims[index(m)];
+        uint32_t mine = uint32_t(depth) << 16 | uint32_t(threadIdx & 0xFFFF);
+        uint32_t cur  = c.load(std::memory_order_relaxed);
+
+        while (cur >> 16 < uint32_t(depth))
+            if (c.compare_exchange_weak(cur, mine, std::memory_order_relaxed))
+                return true;
+
+        return cur == mine;
+    }
+
+    // Records that the move failed low at this depth, with an upper bound of v
+    void refute(Move m, Depth depth, Value v) {
+        auto& r = refutations[index(m)];
+        if (r.load(std::memory_order_relaxed) >> 16 <= uint32_t(depth))
+            r.store(uint32_t(depth) << 16 | uint16_t(int16_t(v)), std::memory_order_relaxed);
+    }
+
+    // Whether the move is known to fail low against alpha at this depth or deeper
+    bool refuted(Move m, Depth depth, Value alpha) const {
+        const uint32_t r = refutations[index(m)].load(std::memory_order_relaxed);
+        return r >> 16 >= uint32_t(depth) && Value(int16_t(r & 0xFFFF)) <= alpha;
+    }
+
+   private:
+    // The from and to squares and the promotion type, under-promotions are distinct
+    static size_t index(Move m) { return m.raw() & 0x3FFF; }
+
+    std::array<std::atomic<uint32_t>, 1 << 14> claims{}, refutations{};
+};
+
 // Null Object Pattern, implement a common interface for the SearchManagers.
 // A Null Object will be given to non-mainthread workers.
 class ISearchManager {
@@ -186,6 +234,22 @@ struct InfoIteration {
     size_t           currmovenumber;
 };
 
+// The ranking of the root moves with the tablebases, before the search starts
+struct InfoRootProbe {
+    size_t moves;
+    size_t timeMs;
+};
+
+// The outcome of one position of a batch analysis, see Worker::analyse()
+struct BatchResult {
+    size_t           id;
+    std::string_view fen;
+    std::string_view bestmove;
+    InfoFull         info;
+};
+
+using UpdateBatch = std::function<void(const BatchResult&)>;
+
 // Skill structure is used to implement strength limit. If we have a UCI_Elo,
 // we convert it to an appropriate skill level, anchored to the Stash engine.
 // This method is based on a fit of the Elo results for games played between
@@ -220,14 +284,16 @@ class SearchManager: public ISearchManager {
    public:
     using UpdateShort    = std::function<void(const InfoShort&)>;
     using UpdateFull     = std::function<void(const InfoFull&)>;
-    using UpdateIter     = std::function<void(const InfoIteration&)>;
-    using UpdateBestmove = std::function<void(std::string_view, std::string_view)>;
+    using UpdateIter      = std::function<void(const InfoIteration&)>;
+    using UpdateBestmove  = std::function<void(std::string_view, std::string_view)>;
+    using UpdateRootProbe = std::function<void(const InfoRootProbe&)>;
 
     struct UpdateContext {
-        UpdateShort    onUpdateNoMoves;
-        UpdateFull     onUpdateFull;
-        UpdateIter     onIter;
-        UpdateBestmove onBestmove;
+        UpdateShort     onUpdateNoMoves;
+        UpdateFull      onUpdateFull;
+        UpdateIter      onIter;
+        UpdateBestmove  onBestmove;
+        UpdateRootProbe onRootProbe;
     };
 
 
@@ -275,14 +341,21 @@ class Worker {
            NumaReplicatedAccessToken);
 
     // Called at instantiation to initialize reductions tables.
-    // Reset histories, usually before a new game.
-    void clear();
+    // Reset histories, usually before a new game. The Finny tables are kept
+    // when asked to, since they only depend on the networks.
+    void clear(bool keepRefreshTable = false);
 
     // Called when the program receives the UCI 'go' command.
     // It searches from the root position and outputs the "bestmove".
     void start_searching();
 
-    bool is_mainthread() const { return threadIdx == 0; }
+    // Searches a position on its own, independently of the other threads
+    void analyse(size_t             id,
+                 const std::string& fen,
+                 const LimitsType&  limits,
+                 const UpdateBatch& onResult);
+
+    bool is_mainthread() const { return threadIdx == 0 && !standalone; }
 
     void ensure_network_replicated();
 
@@ -329,11 +402,23 @@ class Worker {
 
     Value evaluate(const Position&);
 
+    void count_tt_probe(Key key);
+    void check_node_budget();
+
+    // Whether the search must unwind, stopped for all the threads or, in a standalone
+    // search, on spending its own node budget
+    bool stopped() const;
+
     LimitsType limits;
+    bool       nodeBudgetSpent = false;  // Only set by a standalone search
 
-    size_t                pvIdx, pvLast;
-    std::atomic<uint64_t> nodes, tbHits, bestMoveChanges;
-    int                   selDepth, nmpMinPly;
+    size_t                      pvIdx, pvLast;
+    std::atomic<uint64_t>       nodes, tbHits, bestMoveChanges;
+    std::atomic<uint64_t>       ttLocalProbes, ttRemoteProbes;  // Only counted with TT_STATS
+    TTStats                     ttStats;                        // Only counted with TT_STATS
+    Eval::NNUE::EvalProfile     nnueProfile;                    // Only gathered with NNUE_PROFILE
+    Tablebases::ProbeCacheStats tbCacheStats;
+    int                         selDepth, nmpMinPly;
 
     Value optimism[COLOR_NB];
 
@@ -345,6 +430,8 @@ class Worker {
 
     size_t                    threadIdx, numaThreadIdx, numaTotal;
     NumaReplicatedAccessToken numaAccessToken;
+    bool                      standalone = false;  // Searching a position of its own
+    bool                      rootSplit  = false;  // Sharing out the root moves, see RootMoveClaims
 
     // Reductions lookup table initialized at startup
     std::array<int, MAX_MOVES> reductions;  // [depth or moveNumber]
@@ -165,8 +165,13 @@ class SharedMemory: public detail::SharedMemoryBase {
     std::string        sentinel_base_;
     std::string        sentinel_path_;
 
-    static constexpr size_t calculate_total_size() noexcept {
-        return sizeof(T) + sizeof(detail::ShmHeader);
+    static constexpr size_t calculate_total_size(size_t extra_bytes = 0) noexcept {
+        return sizeof(T) + extra_bytes + sizeof(detail::ShmHeader);
+    }
+
+    detail::ShmHeader* header_location() const noexcept {
+        return reinterpret_cast<detail::ShmHeader*>(static_cast<char*>(mapped_ptr_) + total_size_
+                                                    - sizeof(detail::ShmHeader));
     }
 
     static std::string make_sentinel_base(const std::string& name) {
@@ -177,10 +182,14 @@ class SharedMemory: public detail::SharedMemoryBase {
     }
 
    public:
-    explicit SharedMemory(const std::string& name) noexcept :
+    // The region holds a T followed by extra_bytes of zero-initialized storage,
+    // which lets a small T describe a variable-sized payload placed right after it.
+    explicit SharedMemory(const std::string& name, size_t extra_bytes = 0) noexcept :
         name_(name),
-        total_size_(calculate_total_size()),
-        sentinel_base_(make_sentinel_base(name)) {}
+        total_size_(calculate_total_size(extra_bytes)),
+        sentinel_base_(make_sentinel_base(name)) {
+        assert(extra_bytes % alignof(detail::ShmHeader) == 0);
+    }
 
     ~SharedMemory() noexcept override {
         detail::SharedMemoryRegistry::unregister_instance(this);
@@ -368,6 +377,9 @@ class SharedMemory: public detail::SharedMemoryBase {
 
     [[nodiscard]] const T& get() const noexcept { return *data_ptr_; }
 
+    // Writable access to the T and the extra bytes following it
+    [[nodiscard]] void* data() const noexcept { return data_ptr_; }
+
     [[nodiscard]] const T* operator->() const noexcept { return data_ptr_; }
 
     [[nodiscard]] const T& operator*() const noexcept { return *data_ptr_; }
@@ -595,9 +607,8 @@ class SharedMemory: public detail::SharedMemoryBase {
             return false;
         }
 
-        data_ptr_ = static_cast<T*>(mapped_ptr_);
-        header_ptr_ =
-          reinterpret_cast<detail::ShmHeader*>(static_cast<char*>(mapped_ptr_) + sizeof(T));
+        data_ptr_   = static_cast<T*>(mapped_ptr_);
+        header_ptr_ = header_location();
 
         new (header_ptr_) detail::ShmHeader{};
         new (data_ptr_) T{initial_value};
@@ -629,8 +640,7 @@ class SharedMemory: public detail::SharedMemoryBase {
         }
 
         data_ptr_   = static_cast<T*>(mapped_ptr_);
-        header_ptr_ = std::launder(
-          reinterpret_cast<detail::ShmHeader*>(static_cast<char*>(mapped_ptr_) + sizeof(T)));
+        header_ptr_ = std::launder(header_location());
 
         if (!header_ptr_->initialized.load(std::memory_order_acquire)
             || header_ptr_->magic != detail::ShmHeader::SHM_MAGIC)
@@ -645,9 +655,9 @@ class SharedMemory: public detail::SharedMemoryBase {
 };
 
 template<typename T>
-[[nodiscard]] std::optional<SharedMemory<T>> create_shared(const std::string& name,
-                                                           const T& initial_value) noexcept {
-    SharedMemory<T> shm(name);
+[[nodiscard]] std::optional<SharedMemory<T>>
+create_shared(const std::string& name, const T& initial_value, size_t extra_bytes = 0) noexcept {
+    SharedMemory<T> shm(name, extra_bytes);
     if (shm.open(initial_value))
         return shm;
     return std::nullopt;
@@ -21,6 +21,8 @@
 #include <algorithm>
 #include <atomic>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
@@ -28,10 +30,13 @@
 #include <fstream>
 #include <initializer_list>
 #include <iostream>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <sstream>
 #include <string_view>
 #include <sys/stat.h>
+#include <thread>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -180,6 +185,28 @@ struct LR {
 
 static_assert(sizeof(LR) == 3, "LR tree entry must be 3 bytes");
 
+// Size of a tablebase file and checksum of its first bytes, as recorded in the
+// index file. Checked when the file is mapped, because init() trusts the index
+// without opening the files.
+struct FileStamp {
+    static constexpr size_t HeaderSize = 64;
+
+    uint64_t size     = 0;  // Zero if the file was not found or not stamped
+    uint64_t checksum = 0;
+
+    // FNV-1a hash, stable across builds and platforms
+    static uint64_t checksum_of(const uint8_t* data, uint64_t fileSize) {
+        uint64_t h = 0xCBF29CE484222325ULL;
+        for (size_t i = 0; i < std::min(uint64_t(HeaderSize), fileSize); ++i)
+            h = (h ^ data[i]) * 0x100000001B3ULL;
+        return h;
+    }
+};
+
+// Set when a mapped file does not match its stamp, so that the next init() looks
+// for the files again and rewrites the index file instead of loading it
+std::atomic<bool> staleIndex;
+
 // Tablebases data layout is structured as following:
 //
 //  TBFile:   memory maps/unmaps the physical .rtbw and .rtbz files
@@ -202,27 +229,55 @@ class TBFile: public std::ifstream {
     // C:\tb\wdl345;C:\tb\wdl6;D:\tb\dtz345;D:\tb\dtz6
     static std::string Paths;
 
-    TBFile(const std::string& f) {
+    static std::vector<std::string> directories() {
 
 #ifndef _WIN32
         constexpr char SepChar = ':';
 #else
         constexpr char SepChar = ';';
 #endif
-        std::stringstream ss(Paths);
-        std::string       path;
+        std::stringstream        ss(Paths);
+        std::string              path;
+        std::vector<std::string> dirs;
 
         while (std::getline(ss, path, SepChar))
+            dirs.push_back(path);
+
+        return dirs;
+    }
+
+    // Modification time of a directory, which changes when files are added to
+    // or removed from it, or zero if it does not exist.
+    static uint64_t modification_time(const std::string& dir) {
+        struct stat statbuf;
+        return stat(dir.c_str(), &statbuf) ? 0 : uint64_t(statbuf.st_mtime);
+    }
+
+    TBFile(const std::string& f) {
+
+        for (const auto& path : directories())
         {
             fname = path + "/" + f;
-            std::ifstream::open(fname);
+            std::ifstream::open(fname, std::ios::binary);
             if (is_open())
                 return;
         }
     }
 
-    // Memory map the file and check it.
-    uint8_t* map(void** baseAddress, uint64_t* mapping, TBType type) {
+    // Stamp of the open file, to be written to the index file
+    FileStamp stamp() {
+        uint8_t header[FileStamp::HeaderSize] = {};
+
+        seekg(0, std::ios::end);
+        uint64_t size = uint64_t(tellg());
+        seekg(0);
+        read((char*) header, std::streamsize(std::min(uint64_t(sizeof(header)), size)));
+
+        return {size, FileStamp::checksum_of(header, size)};
+    }
+
+    // Memory map the file and check it, also against its stamp from the index file.
+    uint8_t* map(void** baseAddress, uint64_t* mapping, TBType type, const FileStamp& stamp) {
         if (is_open())
             close();  // Need to re-open to get native file descriptor
 
@@ -241,8 +296,9 @@ class TBFile: public std::ifstream {
             exit(EXIT_FAILURE);
         }
 
-        *mapping     = statbuf.st_size;
-        *baseAddress = mmap(nullptr, statbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        uint64_t size = statbuf.st_size;
+        *mapping      = statbuf.st_size;
+        *baseAddress  = mmap(nullptr, statbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
     #if defined(MADV_RANDOM)
         madvise(*baseAddress, statbuf.st_size, MADV_RANDOM);
     #endif
@@ -270,7 +326,8 @@ class TBFile: public std::ifstream {
             exit(EXIT_FAILURE);
         }
 
-        HANDLE mmap = CreateFileMapping(fd, nullptr, PAGE_READONLY, size_high, size_low, nullptr);
+        uint64_t size = (uint64_t(size_high) << 32) | size_low;
+        HANDLE   mmap = CreateFileMapping(fd, nullptr, PAGE_READONLY, size_high, size_low, nullptr);
         CloseHandle(fd);
 
         if (!mmap)
@@ -300,6 +357,17 @@ class TBFile: public std::ifstream {
             return *baseAddress = nullptr, nullptr;
         }
 
+        if (stamp.size
+            && (size != stamp.size || FileStamp::checksum_of(data, size) != stamp.checksum))
+        {
+            std::cerr << "Tablebase file " << fname
+                      << " does not match the index file, it will be rebuilt at the next init"
+                      << std::endl;
+            staleIndex = true;
+            unmap(*baseAddress, *mapping);
+            return *baseAddress = nullptr, nullptr;
+        }
+
         return data + 4;  // Skip Magics's header
     }
 
@@ -354,9 +422,11 @@ struct TBTable {
     static constexpr int Sides = Type == WDL ? 2 : 1;
 
     std::atomic_bool ready;
+    std::mutex       mutex;  // Held while mapping the file, see mapped()
     void*            baseAddress;
     uint8_t*         map;
     uint64_t         mapping;
+    FileStamp        stamp;  // From the index file, see TBTables::load_index()
     Key              key;
     Key              key2;
     int              pieceCount;
@@ -444,6 +514,7 @@ class TBTables {
 
     std::deque<TBTable<WDL>> wdlTable;
     std::deque<TBTable<DTZ>> dtzTable;
+    std::deque<std::string>  codes;  // Like "KRvK", for each entry of wdlTable
     size_t                   foundDTZFiles = 0;
     size_t                   foundWDLFiles = 0;
 
@@ -485,12 +556,16 @@ class TBTables {
         }
     }
 
+    bool stampFiles = false;  // Stamp the files found by add(), to save the index file
+
     void clear() {
         memset(hashTable, 0, sizeof(hashTable));
         wdlTable.clear();
         dtzTable.clear();
+        codes.clear();
         foundDTZFiles = 0;
         foundWDLFiles = 0;
+        stampFiles    = false;
     }
 
     void info() const {
@@ -499,10 +574,105 @@ class TBTables {
     }
 
     void add(const std::vector<PieceType>& pieces);
+    void add(const std::string& code, const FileStamp& wdl, const FileStamp& dtz);
+    bool load_index(const std::string& indexFile);
+    void save_index(const std::string& indexFile) const;
+
+    size_t             size() const { return wdlTable.size(); }
+    const std::string& code(size_t i) const { return codes[i]; }
+
+    template<TBType Type>
+    TBTable<Type>& table(size_t i) {
+        if constexpr (Type == WDL)
+            return wdlTable[i];
+        else
+            return dtzTable[i];
+    }
 };
 
 TBTables TBTables;
 
+// Set by each searching thread, see Tablebases::collect_cache_stats()
+thread_local ProbeCacheStats* threadCacheStats = nullptr;
+
+// A fixed-size cache of probe results, indexed by the position key. Each slot holds
+// the result next to the key xor'ed with it, so that a slot torn by two threads
+// writing at once fails the key check instead of returning a wrong result, and no
+// lock is needed. Failed probes are not cached.
+class ProbeCache {
+
+    static constexpr uint64_t Valid = 1ULL << 63;
+
+    struct Slot {
+        std::atomic<uint64_t> check{0}, data{0};
+    };
+
+    // Half of the largest SyzygyProbeCache, which is split between WDL and DTZ
+    static constexpr size_t MaxCount = size_t(1024) * 1024 * 1024 / 2 / sizeof(Slot);
+
+    std::unique_ptr<Slot[]> slots;
+    uint64_t                mask = 0;
+
+    // Counters of ProbeCacheStats counting the hits and misses of this cache
+    uint64_t ProbeCacheStats::*const hits;
+    uint64_t ProbeCacheStats::*const misses;
+
+   public:
+    ProbeCache(uint64_t ProbeCacheStats::*h, uint64_t ProbeCacheStats::*m) :
+        hits(h),
+        misses(m) {}
+
+    // Not thread safe, no probe may be running
+    void resize(size_t bytes) {
+        const size_t count =
+          bytes >= sizeof(Slot) ? std::min(size_t(1) << msb(bytes / sizeof(Slot)), MaxCount) : 0;
+
+        slots = count ? std::make_unique<Slot[]>(count) : nullptr;
+        mask  = count ? count - 1 : 0;
+    }
+
+    void clear() {
+        if (slots)
+            for (uint64_t i = 0; i <= mask; ++i)
+                slots[i].check = slots[i].data = 0;
+    }
+
+    bool probe(Key key, int* value, ProbeState* result) {
+        if (!slots)
+            return false;
+
+        const Slot&    slot = slots[key & mask];
+        const uint64_t data = slot.data.load(std::memory_order_relaxed);
+
+        if (!(data & Valid) || (slot.check.load(std::memory_order_relaxed) ^ data) != key)
+        {
+            if (threadCacheStats)
+                threadCacheStats->*misses += 1;
+            return false;
+        }
+
+        if (threadCacheStats)
+            threadCacheStats->*hits += 1;
+        *value  = int32_t(uint32_t(data));
+        *result = ProbeState(int8_t(data >> 32));
+        return true;
+    }
+
+    void save(Key key, int value, ProbeState result) {
+        if (!slots || result == FAIL)
+            return;
+
+        const uint64_t data = Valid | uint64_t(uint8_t(result)) << 32 | uint32_t(value);
+
+        Slot& slot = slots[key & mask];
+        slot.check.store(key ^ data, std::memory_order_relaxed);
+        slot.data.store(data, std::memory_order_relaxed);
+    }
+};
+
+ProbeCache WDLCache(&ProbeCacheStats::wdlHits, &ProbeCacheStats::wdlMisses);
+ProbeCache DTZCache(&ProbeCacheStats::dtzHits, &ProbeCacheStats::dtzMisses);
+
 // If the corresponding file exists two new objects TBTable<WDL> and TBTable<DTZ>
 // are created and added to the lists and hash table. Called at init time.
 void TBTables::add(const std::vector<PieceType>& pieces) {
@@ -513,9 +683,14 @@ void TBTables::add(const std::vector<PieceType>& pieces) {
         code += PieceToChar[pt];
     code.insert(code.find('K', 1), "v");
 
+    FileStamp wdl, dtz;
+
     TBFile file_dtz(code + ".rtbz");  // KRK -> KRvK
     if (file_dtz.is_open())
     {
+        if (stampFiles)
+            dtz = file_dtz.stamp();
+
         file_dtz.close();
         foundDTZFiles++;
     }
@@ -525,19 +700,111 @@ void TBTables::add(const std::vector<PieceType>& pieces) {
     if (!file.is_open())  // Only WDL file is checked
         return;
 
+    if (stampFiles)
+        wdl = file.stamp();
+
     file.close();
     foundWDLFiles++;
 
-    MaxCardinality = std::max(int(pieces.size()), MaxCardinality);
+    add(code, wdl, dtz);
+}
+
+void TBTables::add(const std::string& code, const FileStamp& wdl, const FileStamp& dtz) {
+
+    MaxCardinality = std::max(int(code.size()) - 1, MaxCardinality);  // Without the 'v'
 
     wdlTable.emplace_back(code);
     dtzTable.emplace_back(wdlTable.back());
+    codes.push_back(code);
+
+    wdlTable.back().stamp = wdl;
+    dtzTable.back().stamp = dtz;
 
     // Insert into the hash keys for both colors: KRvK with KR white and black
     insert(wdlTable.back().key, &wdlTable.back(), &dtzTable.back());
     insert(wdlTable.back().key2, &wdlTable.back(), &dtzTable.back());
 }
 
+constexpr std::string_view IndexHeader = "Stockfish Syzygy index 1";
+
+// The index file lists the tables found in the directories of TBFile::Paths with
+// the stamps of their files, see save_index(). It is up to date as long as none of
+// the directories has been modified since, and then it replaces looking for every
+// possible file, which is slow with large tablebases on network drives. Returns
+// false, adding no table, if the index file is missing, malformed or stale.
+bool TBTables::load_index(const std::string& indexFile) {
+
+    struct Line {
+        std::string code;
+        FileStamp   wdl, dtz;
+    };
+
+    // Like "KRvK", as TBTable needs a valid code
+    auto valid = [](const std::string& code) {
+        size_t v = code.find('v');
+        return code.size() >= 4 && code.size() <= TBPIECES + 1 && v != std::string::npos
+            && code.find('v', v + 1) == std::string::npos
+            && code.find_first_not_of("KQRBNPv") == std::string::npos
+            && std::count(code.begin(), code.end(), 'K') == 2 && code[0] == 'K'
+            && code[v + 1] == 'K';
+    };
+
+    std::ifstream in(indexFile);
+    std::string   header, paths;
+
+    if (!std::getline(in, header) || header != IndexHeader || !std::getline(in, paths)
+        || paths != TBFile::Paths)
+        return false;
+
+    for (const auto& dir : TBFile::directories())
+    {
+        uint64_t mtime;
+        if (!(in >> mtime) || mtime != TBFile::modification_time(dir))
+            return false;
+    }
+
+    size_t count;
+    if (!(in >> count) || count > Size)
+        return false;
+
+    std::vector<Line> lines(count);
+
+    for (auto& l : lines)
+        if (!(in >> l.code >> l.wdl.size >> l.wdl.checksum >> l.dtz.size >> l.dtz.checksum)
+            || !valid(l.code) || !l.wdl.size)
+            return false;
+
+    for (const auto& l : lines)
+    {
+        foundWDLFiles++;
+        foundDTZFiles += l.dtz.size != 0;
+        add(l.code, l.wdl, l.dtz);
+    }
+
+    return true;
+}
+
+// Writes the tables found by add() with stampFiles set, see load_index()
+void TBTables::save_index(const std::string& indexFile) const {
+
+    std::ofstream out(indexFile);
+
+    out << IndexHeader << '\n' << TBFile::Paths << '\n';
+
+    for (const auto& dir : TBFile::directories())
+        out << TBFile::modification_time(dir) << ' ';
+
+    out << '\n' << codes.size() << '\n';
+
+    for (size_t i = 0; i < codes.size(); ++i)
+        out << codes[i] << ' ' << wdlTable[i].stamp.size << ' ' << wdlTable[i].stamp.checksum
+            << ' ' << dtzTable[i].stamp.size << ' ' << dtzTable[i].stamp.checksum << '\n';
+
+    if (!out)
+        sync_cout << "info string Could not write the tablebase index file " << indexFile
+                  << sync_endl;
+}
+
 // TB tables are compressed with canonical Huffman code. The compressed data is divided into
 // blocks of size d->sizeofBlock, and each block stores a variable number of symbols.
 // Each symbol represents either a WDL or a (remapped) DTZ value, or a pair of other symbols
@@ -1207,26 +1474,10 @@ void set(T& e, uint8_t* data) {
         }
 }
 
-// If the TB file corresponding to the given position is already memory-mapped
-// then return its base address, otherwise, try to memory map and init it. Called
-// at every probe, memory map, and init only at first access. Function is thread
-// safe and can be called concurrently.
+// Maps the file of the table and reads its indexing information, under the lock
+// of the table
 template<TBType Type>
-void* mapped(TBTable<Type>& e, const Position& pos) {
-
-    static std::mutex mutex;
-    // Because TB is the only usage of materialKey, check it here in debug mode
-    assert(pos.material_key_is_ok());
-
-    // Use 'acquire' to avoid a thread reading 'ready' == true while
-    // another is still working. (compiler reordering may cause this).
-    if (e.ready.load(std::memory_order_acquire))
-        return e.baseAddress;  // Could be nullptr if file does not exist
-
-    std::scoped_lock<std::mutex> lk(mutex);
-
-    if (e.ready.load(std::memory_order_relaxed))  // Recheck under lock
-        return e.baseAddress;
+void map_table(TBTable<Type>& e, const Position& pos) {
 
     // Pieces strings in decreasing order for each color, like ("KPP","KR")
     std::string fname, w, b;
@@ -1239,12 +1490,47 @@ void* mapped(TBTable<Type>& e, const Position& pos) {
     fname =
       (e.key == pos.material_key() ? w + 'v' + b : b + 'v' + w) + (Type == WDL ? ".rtbw" : ".rtbz");
 
-    uint8_t* data = TBFile(fname).map(&e.baseAddress, &e.mapping, Type);
+    uint8_t* data = TBFile(fname).map(&e.baseAddress, &e.mapping, Type, e.stamp);
 
     if (data)
         set(e, data);
 
     e.ready.store(true, std::memory_order_release);
+}
+
+// Time in microseconds that probing threads spent waiting for a table to be
+// mapped, by themselves or by another thread, see mapped()
+std::atomic<uint64_t> mappingWaitTime;
+
+// If the TB file corresponding to the given position is already memory-mapped
+// then return its base address, otherwise, try to memory map and init it. Called
+// at every probe, memory map, and init only at first access. Function is thread
+// safe and can be called concurrently. Each table has its own lock, so threads
+// only wait for the mapping of the table they probe, and with countWait the time
+// they waited is added to mappingWaitTime.
+template<TBType Type>
+void* mapped(TBTable<Type>& e, const Position& pos, bool countWait = true) {
+
+    // Because TB is the only usage of materialKey, check it here in debug mode
+    assert(pos.material_key_is_ok());
+
+    // Use 'acquire' to avoid a thread reading 'ready' == true while
+    // another is still working. (compiler reordering may cause this).
+    if (e.ready.load(std::memory_order_acquire))
+        return e.baseAddress;  // Could be nullptr if file does not exist
+
+    const auto start = std::chrono::steady_clock::now();
+
+    std::scoped_lock<std::mutex> lk(e.mutex);
+
+    if (!e.ready.load(std::memory_order_relaxed))  // Recheck under lock
+        map_table(e, pos);
+
+    if (countWait)
+        mappingWaitTime += uint64_t(std::chrono::duration_cast<std::chrono::microseconds>(
+                                      std::chrono::steady_clock::now() - start)
+                                      .count());
+
     return e.baseAddress;
 }
 
@@ -1262,6 +1548,164 @@ Ret probe_table(const Position& pos, ProbeState* result, WDLScore wdl = WDLDraw)
     return do_probe_table(pos, entry, wdl, result);
 }
 
+// Maps a table ahead of its first probe, hinting the kernel to back it with huge
+// pages and, with willNeed, to start reading it in. Returns the bytes newly mapped,
+// or 0 if the table was mapped already or the file is missing.
+template<TBType Type>
+uint64_t premap_table(TBTable<Type>& e, const Position& pos, bool willNeed) {
+
+    // The background thread is not probing, it does not count as waiting
+    if (e.ready.load(std::memory_order_acquire) || !mapped(e, pos, false))
+        return 0;
+
+#ifndef _WIN32
+    #if defined(MADV_HUGEPAGE)
+    madvise(e.baseAddress, e.mapping, MADV_HUGEPAGE);
+    #endif
+    #if defined(MADV_WILLNEED)
+    if (willNeed)
+        madvise(e.baseAddress, e.mapping, MADV_WILLNEED);
+    #endif
+    return e.mapping;
+#else
+    (void) willNeed;
+    return 1;  // The mapping is a handle, the size is not known
+#endif
+}
+
+// Whether the material of a table, like "KRPvKR", remains after captures from the
+// given piece counts, with either side of the table as White. Promotions are not
+// considered.
+bool reachable(const std::string& code, const std::array<int, PIECE_NB>& material) {
+
+    const std::string_view left(code.data(), code.find('v'));
+    const std::string_view right(code.data() + left.size() + 1, code.size() - left.size() - 1);
+
+    auto within = [&](std::string_view side, Color c) {
+        for (PieceType pt = PAWN; pt <= KING; ++pt)
+            if (std::count(side.begin(), side.end(), PieceToChar[pt]) > material[make_piece(c, pt)])
+                return false;
+        return true;
+    };
+
+    return (within(left, WHITE) && within(right, BLACK))
+        || (within(left, BLACK) && within(right, WHITE));
+}
+
+// Selects and maps tables on a background thread, started at the first request.
+// A new request replaces the pending one and stops the run in progress after its
+// current table, without waiting for it, so that go is not held up.
+class Premapper {
+
+   public:
+    struct Request {
+        int                       limit;
+        bool                      willNeed;
+        bool                      root;      // Only the tables reachable from material
+        std::array<int, PIECE_NB> material;  // Piece counts of the root position
+    };
+
+    ~Premapper() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.reset();
+            stop = exit = true;
+        }
+        cv.notify_all();
+
+        if (thread.joinable())
+            thread.join();
+    }
+
+    void start(const Request& request) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending = request;
+            stop    = true;
+
+            if (!thread.joinable())
+                thread = std::thread(&Premapper::idle_loop, this);
+        }
+        cv.notify_all();
+    }
+
+    // Drops the pending request and waits for the run in progress to stop
+    void halt() {
+        std::unique_lock<std::mutex> lock(mutex);
+        pending.reset();
+        stop = true;
+        cv.wait(lock, [&] { return !busy; });
+    }
+
+    // Waits for the requests made so far and returns the result of the last run
+    PremapStats wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] { return !busy && !pending; });
+        return last;
+    }
+
+   private:
+    void idle_loop() {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        while (true)
+        {
+            cv.wait(lock, [&] { return exit || pending; });
+
+            if (exit)
+                return;
+
+            const Request request = *pending;
+            pending.reset();
+            stop = false;
+            busy = true;
+            lock.unlock();
+
+            const PremapStats stats = run(request);
+
+            lock.lock();
+            last = stats;
+            busy = false;
+            cv.notify_all();
+        }
+    }
+
+    PremapStats run(const Request& request) {
+        const TimePoint start = now();
+        PremapStats     stats;
+
+        for (size_t i = 0; i < TBTables.size() && !stop; ++i)
+        {
+            if (TBTables.table<WDL>(i).pieceCount > request.limit
+                || (request.root && !reachable(TBTables.code(i), request.material)))
+                continue;
+
+            StateInfo st;
+            Position  pos;
+            pos.set(TBTables.code(i), WHITE, &st);
+
+            for (uint64_t b : {premap_table(TBTables.table<WDL>(i), pos, request.willNeed),
+                               premap_table(TBTables.table<DTZ>(i), pos, request.willNeed)})
+                if (b)
+                    stats.files++, stats.bytes += b;
+        }
+
+        stats.milliseconds = now() - start;
+        return stats;
+    }
+
+    std::mutex              mutex;
+    std::condition_variable cv;
+    std::thread             thread;
+    std::optional<Request>  pending;
+    std::atomic<bool>       stop{false};
+    bool                    busy = false, exit = false;
+    PremapStats             last;
+};
+
+// Destroyed before TBTables, so that a running premap is stopped first
+Premapper premapper;
+
 // For a position where the side to move has a winning capture it is not necessary
 // to store a winning value so the generator treats such positions as "don't care"
 // and tries to assign to it a value that improves the compression ratio. Similarly,
@@ -1335,13 +1779,101 @@ WDLScore search(Position& pos, ProbeState* result) {
     return *result = OK, value;
 }
 
+
+// Probes the DTZ table for probe_dtz(), which checks the DTZ cache first
+int probe_dtz_uncached(Position& pos, ProbeState* result) {
+
+    *result      = OK;
+    WDLScore wdl = search<true>(pos, result);
+
+    if (*result == FAIL || wdl == WDLDraw)  // DTZ tables don't store draws
+        return 0;
+
+    // DTZ stores a 'don't care value in this case, or even a plain wrong
+    // one as in case the best move is a losing ep, so it cannot be probed.
+    if (*result == ZEROING_BEST_MOVE)
+        return dtz_before_zeroing(wdl);
+
+    int dtz = probe_table<DTZ>(pos, result, wdl);
+
+    if (*result == FAIL)
+        return 0;
+
+    if (*result != CHANGE_STM)
+        return (dtz + 100 * (wdl == WDLBlessedLoss || wdl == WDLCursedWin)) * sign_of(wdl);
+
+    // DTZ stores results for the other side, so we need to do a 1-ply search and
+    // find the winning move that minimizes DTZ.
+    StateInfo st;
+    int       minDTZ = 0xFFFF;
+
+    for (const Move move : MoveList<LEGAL>(pos))
+    {
+        bool zeroing = pos.capture(move) || type_of(pos.moved_piece(move)) == PAWN;
+
+        pos.do_move(move, st);
+
+        // For zeroing moves we want the dtz of the move _before_ doing it,
+        // otherwise we will get the dtz of the next move sequence. Search the
+        // position after the move to get the score sign (because even in a
+        // winning position we could make a losing capture or go for a draw).
+        dtz = zeroing ? -dtz_before_zeroing(search<false>(pos, result)) : -probe_dtz(pos, result);
+
+        // If the move mates, force minDTZ to 1
+        if (dtz == 1 && pos.checkers() && MoveList<LEGAL>(pos).size() == 0)
+            minDTZ = 1;
+
+        // Convert result from 1-ply search. Zeroing moves are already accounted
+        // by dtz_before_zeroing() that returns the DTZ of the previous move.
+        if (!zeroing)
+            dtz += sign_of(dtz);
+
+        // Skip the draws and if we are winning only pick positive dtz
+        if (dtz < minDTZ && sign_of(dtz) == sign_of(wdl))
+            minDTZ = dtz;
+
+        pos.undo_move(move);
+
+        if (*result == FAIL)
+            return 0;
+    }
+
+    // When there are no legal moves, the position is mate: we return -1
+    return minDTZ == 0xFFFF ? -1 : minDTZ;
+}
+
+// Calls probe(child, i) for each (i, fen) pair on the threads of run. Position
+// cannot be copied, so every probe sets up the child position from its FEN.
+template<typename Probe>
+void probe_in_parallel(const ProbeRunner&                                 run,
+                       const std::vector<std::pair<size_t, std::string>>& children,
+                       bool                                               isChess960,
+                       const Probe&                                       probe) {
+
+    run(children.size(), [&](size_t j) {
+        StateInfo st;
+        Position  child;
+        child.set(children[j].second, isChess960, &st);
+        probe(child, children[j].first);
+    });
+}
+
 }  // namespace
 
 
 // Called at startup and after every change to
 // "SyzygyPath" UCI option to (re)create the various tables. It is not thread
 // safe, nor it needs to be.
-void Tablebases::init(const std::string& paths) {
+void Tablebases::init(const std::string& paths, const std::string& indexFile) {
+
+    premapper.halt();
+
+    // The cached results stay valid as long as the same tables are found
+    if (paths != TBFile::Paths)
+    {
+        WDLCache.clear();
+        DTZCache.clear();
+    }
 
     TBTables.clear();
     MaxCardinality = 0;
@@ -1444,6 +1976,17 @@ void Tablebases::init(const std::string& paths) {
             LeadPawnsSize[leadPawnsCnt][f] = idx;
         }
 
+    // Add entries in TB tables from the index file if it is up to date and no
+    // file has been found not to match it since it was loaded
+    if (!indexFile.empty() && !staleIndex.exchange(false) && TBTables.load_index(indexFile))
+    {
+        sync_cout << "info string Loaded tablebase index file " << indexFile << sync_endl;
+        TBTables.info();
+        return;
+    }
+
+    TBTables.stampFiles = !indexFile.empty();
+
     // Add entries in TB tables if the corresponding ".rtbw" file exists
     for (PieceType p1 = PAWN; p1 < KING; ++p1)
     {
@@ -1487,9 +2030,64 @@ void Tablebases::init(const std::string& paths) {
         }
     }
 
+    if (!indexFile.empty())
+        TBTables.save_index(indexFile);
+
     TBTables.info();
 }
 
+// Maps in the background the tables selected by the SyzygyPremap option, up to
+// SyzygyProbeLimit pieces: with "all" every table found when called without a root
+// position, with "root" those reachable by captures from the root position given
+// at each go, as long as it is within a few pieces of the tables. The tables are
+// selected on the premapping thread, the caller only hands over the material.
+void Tablebases::premap(const OptionsMap& options, const Position* root) {
+
+    constexpr int RootMargin = 2;  // Pieces the root may have above the largest tables
+
+    if (options["SyzygyPremap"] != (root ? "root" : "all") || !TBTables.size())
+        return;
+
+    const int limit = std::min(int(options["SyzygyProbeLimit"]), MaxCardinality);
+
+    if (root && root->count<ALL_PIECES>() > limit + RootMargin)
+        return;
+
+    Premapper::Request request{limit, bool(options["SyzygyWillNeed"]), root != nullptr, {}};
+
+    if (root)
+        for (Color c : {WHITE, BLACK})
+            for (PieceType pt = PAWN; pt <= KING; ++pt)
+                request.material[make_piece(c, pt)] = popcount(root->pieces(c, pt));
+
+    premapper.start(request);
+}
+
+// Waits for the premapping requested so far and returns what its last run mapped
+PremapStats Tablebases::premap_stats() { return premapper.wait(); }
+
+// Makes the probe cache hits and misses of the calling thread count in `stats`,
+// so that searching threads do not share counters on the probing path.
+void Tablebases::collect_cache_stats(ProbeCacheStats* stats) { threadCacheStats = stats; }
+
+ProbeCacheStats& ProbeCacheStats::operator+=(const ProbeCacheStats& s) {
+    wdlHits += s.wdlHits;
+    wdlMisses += s.wdlMisses;
+    dtzHits += s.dtzHits;
+    dtzMisses += s.dtzMisses;
+    return *this;
+}
+
+// Resizes the WDL and DTZ probe caches, each taking half of the given size, and
+// empties them. Not thread safe, there may be no probe running.
+void Tablebases::set_probe_cache_size(size_t mb) {
+    WDLCache.resize(mb * 1024 * 1024 / 2);
+    DTZCache.resize(mb * 1024 * 1024 / 2);
+}
+
+// Time in microseconds that probing threads spent waiting for tables to be mapped
+uint64_t Tablebases::mapping_wait_time() { return mappingWaitTime; }
+
 // Probe the WDL table for a particular position.
 // If *result != FAIL, the probe was successful.
 // The return value is from the point of view of the side to move:
@@ -1500,8 +2098,15 @@ void Tablebases::init(const std::string& paths) {
 //  2 : win
 WDLScore Tablebases::probe_wdl(Position& pos, ProbeState* result) {
 
-    *result = OK;
-    return search<false>(pos, result);
+    int cached;
+    if (WDLCache.probe(pos.key(), &cached, result))
+        return WDLScore(cached);
+
+    *result      = OK;
+    WDLScore wdl = search<false>(pos, result);
+
+    WDLCache.save(pos.key(), wdl, *result);
+    return wdl;
 }
 
 // Probe the DTZ table for a particular position.
@@ -1532,63 +2137,14 @@ WDLScore Tablebases::probe_wdl(Position& pos, ProbeState* result) {
 // then do not accept moves leading to dtz + 50-move-counter == 100.
 int Tablebases::probe_dtz(Position& pos, ProbeState* result) {
 
-    *result      = OK;
-    WDLScore wdl = search<true>(pos, result);
-
-    if (*result == FAIL || wdl == WDLDraw)  // DTZ tables don't store draws
-        return 0;
-
-    // DTZ stores a 'don't care value in this case, or even a plain wrong
-    // one as in case the best move is a losing ep, so it cannot be probed.
-    if (*result == ZEROING_BEST_MOVE)
-        return dtz_before_zeroing(wdl);
-
-    int dtz = probe_table<DTZ>(pos, result, wdl);
-
-    if (*result == FAIL)
-        return 0;
-
-    if (*result != CHANGE_STM)
-        return (dtz + 100 * (wdl == WDLBlessedLoss || wdl == WDLCursedWin)) * sign_of(wdl);
-
-    // DTZ stores results for the other side, so we need to do a 1-ply search and
-    // find the winning move that minimizes DTZ.
-    StateInfo st;
-    int       minDTZ = 0xFFFF;
-
-    for (const Move move : MoveList<LEGAL>(pos))
-    {
-        bool zeroing = pos.capture(move) || type_of(pos.moved_piece(move)) == PAWN;
-
-        pos.do_move(move, st);
-
-        // For zeroing moves we want the dtz of the move _before_ doing it,
-        // otherwise we will get the dtz of the next move sequence. Search the
-        // position after the move to get the score sign (because even in a
-        // winning position we could make a losing capture or go for a draw).
-        dtz = zeroing ? -dtz_before_zeroing(search<false>(pos, result)) : -probe_dtz(pos, result);
-
-        // If the move mates, force minDTZ to 1
-        if (dtz == 1 && pos.checkers() && MoveList<LEGAL>(pos).size() == 0)
-            minDTZ = 1;
-
-        // Convert result from 1-ply search. Zeroing moves are already accounted
-        // by dtz_before_zeroing() that returns the DTZ of the previous move.
-        if (!zeroing)
-            dtz += sign_of(dtz);
-
-        // Skip the draws and if we are winning only pick positive dtz
-        if (dtz < minDTZ && sign_of(dtz) == sign_of(wdl))
-            minDTZ = dtz;
+    int dtz;
+    if (DTZCache.probe(pos.key(), &dtz, result))
+        return dtz;
 
-        pos.undo_move(move);
+    dtz = probe_dtz_uncached(pos, result);
 
-        if (*result == FAIL)
-            return 0;
-    }
-
-    // When there are no legal moves, the position is mate: we return -1
-    return minDTZ == 0xFFFF ? -1 : minDTZ;
+    DTZCache.save(pos.key(), dtz, *result);
+    return dtz;
 }
 
 
@@ -1599,10 +2155,10 @@ bool Tablebases::root_probe(Position&                    pos,
                             Search::RootMoves&           rootMoves,
                             bool                         rule50,
                             bool                         rankDTZ,
-                            const std::function<bool()>& time_abort) {
+                            const std::function<bool()>& time_abort,
+                            const ProbeRunner&           run) {
 
-    ProbeState result = OK;
-    StateInfo  st;
+    StateInfo st;
 
     // Obtain 50-move counter for the root position
     int cnt50 = pos.rule50_count();
@@ -1610,42 +2166,76 @@ bool Tablebases::root_probe(Position&                    pos,
     // Check whether a position was repeated since the last zeroing move.
     bool rep = pos.has_repeated();
 
-    int dtz, bound = rule50 ? (MAX_DTZ / 2 - 100) : 1;
+    int bound = rule50 ? (MAX_DTZ / 2 - 100) : 1;
 
-    // Probe and rank each move
-    for (auto& m : rootMoves)
-    {
-        pos.do_move(m.pv[0], st);
+    std::vector<int>                             dtzs(rootMoves.size(), 0);
+    std::vector<ProbeState>                      results(rootMoves.size(), OK);
+    std::vector<std::pair<size_t, std::string>> children;
 
-        // Calculate dtz for the current move counting from the root position
-        if (pos.rule50_count() == 0)
+    // Calculate dtz for the move leading to child counting from the root position
+    auto probe = [&](Position& child, size_t i) {
+        if (run && time_abort())
         {
-            // In case of a zeroing move, dtz is one of -101/-1/0/1/101
-            WDLScore wdl = -probe_wdl(pos, &result);
-            dtz          = dtz_before_zeroing(wdl);
+            results[i] = FAIL;
+            return;
         }
-        else if ((rule50 && pos.is_draw(1)) || pos.is_repetition(1))
+
+        int dtz;
+
+        if (child.rule50_count() == 0)
         {
-            // In case a root move leads to a draw by repetition or 50-move rule,
-            // we set dtz to zero. Note: since we are only 1 ply from the root,
-            // this must be a true 3-fold repetition inside the game history.
-            dtz = 0;
+            // In case of a zeroing move, dtz is one of -101/-1/0/1/101
+            WDLScore wdl = -probe_wdl(child, &results[i]);
+            dtz          = dtz_before_zeroing(wdl);
         }
         else
         {
             // Otherwise, take dtz for the new position and correct by 1 ply
-            dtz = -probe_dtz(pos, &result);
+            dtz = -probe_dtz(child, &results[i]);
             dtz = dtz > 0 ? dtz + 1 : dtz < 0 ? dtz - 1 : dtz;
         }
 
         // Make sure that a mating move is assigned a dtz value of 1
-        if (pos.checkers() && dtz == 2 && MoveList<LEGAL>(pos).size() == 0)
+        if (child.checkers() && dtz == 2 && MoveList<LEGAL>(child).size() == 0)
             dtz = 1;
 
-        pos.undo_move(m.pv[0]);
+        dtzs[i] = dtz;
+    };
+
+    // Probe each move, or collect the moves to be probed in parallel
+    for (size_t i = 0; i < rootMoves.size(); ++i)
+    {
+        pos.do_move(rootMoves[i].pv[0], st);
+
+        // In case a root move leads to a draw by repetition or 50-move rule,
+        // we set dtz to zero. Note: since we are only 1 ply from the root,
+        // this must be a true 3-fold repetition inside the game history.
+        if (pos.rule50_count() != 0 && ((rule50 && pos.is_draw(1)) || pos.is_repetition(1)))
+            dtzs[i] = 0;
+        else if (run)
+            children.emplace_back(i, pos.fen());
+        else
+            probe(pos, i);
+
+        pos.undo_move(rootMoves[i].pv[0]);
+
+        if (!run && (time_abort() || results[i] == FAIL))
+            return false;
+    }
+
+    if (run)
+    {
+        probe_in_parallel(run, children, pos.is_chess960(), probe);
 
-        if (time_abort() || result == FAIL)
+        if (time_abort() || std::find(results.begin(), results.end(), FAIL) != results.end())
             return false;
+    }
+
+    // Rank each move
+    for (size_t i = 0; i < rootMoves.size(); ++i)
+    {
+        auto& m   = rootMoves[i];
+        int   dtz = dtzs[i];
 
         // Better moves are ranked higher. Certain wins are ranked equally.
         // Losing moves are ranked equally unless a 50-move draw is in sight.
@@ -1675,29 +2265,50 @@ bool Tablebases::root_probe(Position&                    pos,
 // This is a fallback for the case that some or all DTZ tables are missing.
 //
 // A return value false indicates that not all probes were successful.
-bool Tablebases::root_probe_wdl(Position& pos, Search::RootMoves& rootMoves, bool rule50) {
+bool Tablebases::root_probe_wdl(Position&          pos,
+                                Search::RootMoves& rootMoves,
+                                bool               rule50,
+                                const ProbeRunner& run) {
 
     static const int WDL_to_rank[] = {-MAX_DTZ, -MAX_DTZ + 101, 0, MAX_DTZ - 101, MAX_DTZ};
 
-    ProbeState result = OK;
-    StateInfo  st;
-    WDLScore   wdl;
+    StateInfo st;
+
+    std::vector<WDLScore>                        wdls(rootMoves.size(), WDLDraw);
+    std::vector<ProbeState>                      results(rootMoves.size(), OK);
+    std::vector<std::pair<size_t, std::string>> children;
 
+    auto probe = [&](Position& child, size_t i) { wdls[i] = -probe_wdl(child, &results[i]); };
 
-    // Probe and rank each move
-    for (auto& m : rootMoves)
+    // Probe each move, or collect the moves to be probed in parallel
+    for (size_t i = 0; i < rootMoves.size(); ++i)
     {
-        pos.do_move(m.pv[0], st);
+        pos.do_move(rootMoves[i].pv[0], st);
 
         if (pos.is_draw(1))
-            wdl = WDLDraw;
+            wdls[i] = WDLDraw;
+        else if (run)
+            children.emplace_back(i, pos.fen());
         else
-            wdl = -probe_wdl(pos, &result);
+            probe(pos, i);
 
-        pos.undo_move(m.pv[0]);
+        pos.undo_move(rootMoves[i].pv[0]);
 
-        if (result == FAIL)
+        if (results[i] == FAIL)
             return false;
+    }
+
+    if (run)
+        probe_in_parallel(run, children, pos.is_chess960(), probe);
+
+    if (std::find(results.begin(), results.end(), FAIL) != results.end())
+        return false;
+
+    // Rank each move
+    for (size_t i = 0; i < rootMoves.size(); ++i)
+    {
+        auto&    m   = rootMoves[i];
+        WDLScore wdl = wdls[i];
 
         m.tbRank = WDL_to_rank[wdl + 2];
 
@@ -1713,7 +2324,8 @@ Config Tablebases::rank_root_moves(const OptionsMap&            options,
                                    Position&                    pos,
                                    Search::RootMoves&           rootMoves,
                                    bool                         rankDTZ,
-                                   const std::function<bool()>& time_abort) {
+                                   const std::function<bool()>& time_abort,
+                                   const ProbeRunner&           run) {
     Config config;
 
     if (rootMoves.empty())
@@ -1738,13 +2350,13 @@ Config Tablebases::rank_root_moves(const OptionsMap&            options,
     {
         // Rank moves using DTZ tables, bail out if time_abort flags zeitnot
         config.rootInTB =
-          root_probe(pos, rootMoves, options["Syzygy50MoveRule"], rankDTZ, time_abort);
+          root_probe(pos, rootMoves, options["Syzygy50MoveRule"], rankDTZ, time_abort, run);
 
         if (!config.rootInTB && !time_abort())
         {
             // DTZ tables are missing; try to rank moves using WDL tables
             dtz_available   = false;
-            config.rootInTB = root_probe_wdl(pos, rootMoves, options["Syzygy50MoveRule"]);
+            config.rootInTB = root_probe_wdl(pos, rootMoves, options["Syzygy50MoveRule"], run);
         }
     }
 
@@ -19,6 +19,8 @@
 #ifndef TBPROBE_H
 #define TBPROBE_H
 
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <string>
 #include <vector>
@@ -61,24 +63,51 @@ enum ProbeState {
     ZEROING_BEST_MOVE = 2    // Best move zeroes DTZ (capture or pawn move)
 };
 
+// Runs f(0), ..., f(count - 1) in parallel, returning when they are all done
+using ProbeRunner = std::function<void(size_t count, const std::function<void(size_t)>& f)>;
+
+// Hits and misses of the WDL and DTZ probe caches, counted by each thread
+struct ProbeCacheStats {
+    uint64_t wdlHits = 0, wdlMisses = 0, dtzHits = 0, dtzMisses = 0;
+
+    ProbeCacheStats& operator+=(const ProbeCacheStats& s);
+};
+
+// Tablebase files mapped by the last run of the premapping thread, and how long it took
+struct PremapStats {
+    size_t   files        = 0;
+    uint64_t bytes        = 0;
+    int64_t  milliseconds = 0;
+};
+
 extern int MaxCardinality;
 
 
-void     init(const std::string& paths);
-WDLScore probe_wdl(Position& pos, ProbeState* result);
-int      probe_dtz(Position& pos, ProbeState* result);
-bool     root_probe(Position&                    pos,
-                    Search::RootMoves&           rootMoves,
-                    bool                         rule50,
-                    bool                         rankDTZ,
-                    const std::function<bool()>& time_abort);
-bool     root_probe_wdl(Position& pos, Search::RootMoves& rootMoves, bool rule50);
-Config   rank_root_moves(
+void            init(const std::string& paths, const std::string& indexFile = "");
+void            premap(const OptionsMap& options, const Position* root = nullptr);
+PremapStats     premap_stats();
+void            set_probe_cache_size(size_t mb);
+void            collect_cache_stats(ProbeCacheStats* stats);
+uint64_t        mapping_wait_time();
+WDLScore        probe_wdl(Position& pos, ProbeState* result);
+int             probe_dtz(Position& pos, ProbeState* result);
+bool            root_probe(Position&                    pos,
+                           Search::RootMoves&           rootMoves,
+                           bool                         rule50,
+                           bool                         rankDTZ,
+                           const std::function<bool()>& time_abort,
+                           const ProbeRunner&           run = nullptr);
+bool            root_probe_wdl(Position&          pos,
+                               Search::RootMoves& rootMoves,
+                               bool               rule50,
+                               const ProbeRunner& run = nullptr);
+Config          rank_root_moves(
     const OptionsMap&            options,
     Position&                    pos,
     Search::RootMoves&           rootMoves,
     bool                         rankDTZ    = false,
-    const std::function<bool()>& time_abort = []() { return false; });
+    const std::function<bool()>& time_abort = []() { return false; },
+    const ProbeRunner&           run        = nullptr);
 
 }  // namespace Stockfish::Tablebases
 
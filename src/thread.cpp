@@ -19,10 +19,12 @@
 #include "thread.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <deque>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <utility>
@@ -87,9 +89,9 @@ void Thread::start_searching() {
 }
 
 // Clears the histories for the thread worker (usually before a new game)
-void Thread::clear_worker() {
+void Thread::clear_worker(bool keepRefreshTable) {
     assert(worker != nullptr);
-    run_custom_job([this]() { worker->clear(); });
+    run_custom_job([this, keepRefreshTable]() { worker->clear(keepRefreshTable); });
 }
 
 // Blocks on the condition variable until the thread has finished searching
@@ -140,6 +142,38 @@ Search::SearchManager* ThreadPool::main_manager() { return main_thread()->worker
 
 uint64_t ThreadPool::nodes_searched() const { return accumulate(&Search::Worker::nodes); }
 uint64_t ThreadPool::tb_hits() const { return accumulate(&Search::Worker::tbHits); }
+uint64_t ThreadPool::tt_local_probes() const { return accumulate(&Search::Worker::ttLocalProbes); }
+uint64_t ThreadPool::tt_remote_probes() const {
+    return accumulate(&Search::Worker::ttRemoteProbes);
+}
+
+TTStats ThreadPool::tt_stats() const {
+    TTStats sum;
+    for (auto&& th : threads)
+        sum += th->worker->ttStats;
+    return sum;
+}
+
+Eval::NNUE::EvalProfile ThreadPool::nnue_profile() const {
+    Eval::NNUE::EvalProfile sum;
+    for (auto&& th : threads)
+        sum += th->worker->nnueProfile;
+    return sum;
+}
+
+Tablebases::ProbeCacheStats ThreadPool::tb_cache_stats() const {
+    Tablebases::ProbeCacheStats sum;
+    for (auto&& th : threads)
+        sum += th->worker->tbCacheStats;
+    return sum;
+}
+
+Eval::NNUE::AccumulatorStats ThreadPool::accumulator_stats() const {
+    Eval::NNUE::AccumulatorStats sum;
+    for (auto&& th : threads)
+        sum += th->worker->accumulatorStack.stats();
+    return sum;
+}
 
 static size_t next_power_of_two(uint64_t count) { return count > 1 ? (2ULL << msb(count - 1)) : 1; }
 
@@ -150,10 +184,18 @@ void ThreadPool::set(const NumaConfig&                           numaConfig,
                      Search::SharedState                         sharedState,
                      const Search::SearchManager::UpdateContext& updateContext) {
 
+    // With warm Finny tables the main thread's tables outlive the threads and
+    // seed the new ones, so resizing does not cost every thread a cold start.
+    std::unique_ptr<Eval::NNUE::AccumulatorCaches> seedTable;
+
     if (threads.size() > 0)  // destroy any existing thread(s)
     {
         main_thread()->wait_for_search_finished();
 
+        if (sharedState.options["WarmFinnyTables"])
+            seedTable = std::make_unique<Eval::NNUE::AccumulatorCaches>(
+              main_thread()->worker->refreshTable);
+
         threads.clear();
 
         boundThreadToNumaNode.clear();
@@ -233,18 +275,29 @@ void ThreadPool::set(const NumaConfig&                           numaConfig,
 
         clear();
 
+        // Each thread copies the tables itself, so that they are first touched
+        // on its own NUMA node.
+        if (seedTable)
+        {
+            for (auto&& th : threads)
+                th->run_custom_job([&th, &seedTable]() { th->worker->refreshTable = *seedTable; });
+
+            for (auto&& th : threads)
+                th->wait_for_search_finished();
+        }
+
         main_thread()->wait_for_search_finished();
     }
 }
 
 
 // Sets threadPool data to initial values
-void ThreadPool::clear() {
+void ThreadPool::clear(bool keepRefreshTables) {
     if (threads.size() == 0)
         return;
 
     for (auto&& th : threads)
-        th->clear_worker();
+        th->clear_worker(keepRefreshTables);
 
     for (auto&& th : threads)
         th->wait_for_search_finished();
@@ -272,6 +325,47 @@ void ThreadPool::wait_on_thread(size_t threadId) {
 size_t ThreadPool::num_threads() const { return threads.size(); }
 
 
+// Searches many positions at once, each thread taking the next one from `next`
+// as soon as it is done with the previous one, so that no thread waits for the
+// slowest search. Returns when `next` runs out of positions or on a stop.
+void ThreadPool::analyse(const std::function<bool(std::string&)>& next,
+                         const Search::LimitsType&                 limits,
+                         const Search::UpdateBatch&                onResult) {
+
+    main_thread()->wait_for_search_finished();
+
+    stop = abortedSearch = false;
+    increaseDepth        = true;
+
+    std::mutex mutex;
+    size_t     count = 0;
+    bool       done  = false;  // The input must not be read past its end
+
+    for (auto&& th : threads)
+    {
+        th->run_custom_job([&]() {
+            std::string fen;
+
+            while (true)
+            {
+                size_t id;
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (done || stop || (done = !next(fen)))
+                        return;
+                    id = count++;
+                }
+
+                th->worker->analyse(id, fen, limits, onResult);
+            }
+        });
+    }
+
+    for (auto&& th : threads)
+        th->wait_for_search_finished();
+}
+
+
 // Wakes up main thread waiting in idle_loop() and returns immediately.
 // Main thread will wake up other threads and start the search.
 void ThreadPool::start_thinking(const OptionsMap&  options,
@@ -286,6 +380,9 @@ void ThreadPool::start_thinking(const OptionsMap&  options,
 
     increaseDepth = true;
 
+    if (options["RootSplit"])
+        rootClaims.clear();
+
     Search::RootMoves rootMoves;
     const auto        legalmoves = MoveList<LEGAL>(pos);
 
@@ -301,7 +398,28 @@ void ThreadPool::start_thinking(const OptionsMap&  options,
         for (const auto& m : legalmoves)
             rootMoves.emplace_back(m);
 
-    Tablebases::Config tbConfig = Tablebases::rank_root_moves(options, pos, rootMoves);
+    // All threads are idle, so spread the root tablebase probes over them. Each
+    // thread claims the next move to probe, as probe times vary a lot with cold files.
+    auto runProbes = [this](size_t count, const std::function<void(size_t)>& probe) {
+        std::atomic<size_t> next{0};
+
+        for (auto&& th : threads)
+            th->run_custom_job([&]() {
+                for (size_t i; (i = next++) < count;)
+                    probe(i);
+            });
+
+        for (auto&& th : threads)
+            th->wait_for_search_finished();
+    };
+
+    const TimePoint    probeStart = now();
+    Tablebases::Config tbConfig   = Tablebases::rank_root_moves(
+      options, pos, rootMoves, false, []() { return false; }, runProbes);
+
+    // Report the latency of the probes made before the search starts
+    if (tbConfig.rootInTB)
+        main_manager()->updates.onRootProbe({rootMoves.size(), size_t(now() - probeStart)});
 
     // After ownership transfer 'states' becomes empty, so if we stop the search
     // and call 'go' again without setting a new position states.get() == nullptr.
@@ -321,6 +439,7 @@ void ThreadPool::start_thinking(const OptionsMap&  options,
             th->worker->limits = limits;
             th->worker->nodes = th->worker->tbHits = th->worker->bestMoveChanges = 0;
             th->worker->nmpMinPly                                                = 0;
+            th->worker->ttLocalProbes = th->worker->ttRemoteProbes = 0;
             th->worker->rootDepth = th->worker->completedDepth = 0;
             th->worker->rootMoves                              = rootMoves;
             th->worker->rootPos.set(pos.fen(), pos.is_chess960(), &th->worker->rootState);
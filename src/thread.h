@@ -26,6 +26,7 @@
 #include <functional>
 #include <memory>
 #include <mutex>
+#include <string>
 #include <vector>
 
 #include "memory.h"
@@ -83,7 +84,7 @@ class Thread {
 
     void idle_loop();
     void start_searching();
-    void clear_worker();
+    void clear_worker(bool keepRefreshTable = false);
     void run_custom_job(std::function<void()> f);
 
     void ensure_network_replicated();
@@ -136,24 +137,37 @@ class ThreadPool {
     void   run_on_thread(size_t threadId, std::function<void()> f);
     void   wait_on_thread(size_t threadId);
     size_t num_threads() const;
-    void   clear();
+    void   clear(bool keepRefreshTables = false);
     void   set(const NumaConfig& numaConfig,
                Search::SharedState,
                const Search::SearchManager::UpdateContext&);
 
-    Search::SearchManager* main_manager();
-    Thread*                main_thread() const { return threads.front().get(); }
-    uint64_t               nodes_searched() const;
-    uint64_t               tb_hits() const;
-    Thread*                get_best_thread() const;
-    void                   start_searching();
-    void                   wait_for_search_finished() const;
+    Search::SearchManager*       main_manager();
+    Thread*                      main_thread() const { return threads.front().get(); }
+    uint64_t                     nodes_searched() const;
+    uint64_t                     tb_hits() const;
+    uint64_t                     tt_local_probes() const;
+    uint64_t                     tt_remote_probes() const;
+    TTStats                      tt_stats() const;
+    Eval::NNUE::AccumulatorStats accumulator_stats() const;
+    Eval::NNUE::EvalProfile      nnue_profile() const;
+    Tablebases::ProbeCacheStats  tb_cache_stats() const;
+    Thread*                      get_best_thread() const;
+    void                         start_searching();
+    void                         wait_for_search_finished() const;
+    void                         analyse(const std::function<bool(std::string&)>& next,
+                                         const Search::LimitsType&                 limits,
+                                         const Search::UpdateBatch&                onResult);
 
     std::vector<size_t> get_bound_thread_count_by_numa_node() const;
+    const std::vector<NumaIndex>& get_bound_thread_numa_nodes() const {
+        return boundThreadToNumaNode;
+    }
 
     void ensure_network_replicated();
 
-    std::atomic_bool stop, abortedSearch, increaseDepth;
+    std::atomic_bool       stop, abortedSearch, increaseDepth;
+    Search::RootMoveClaims rootClaims;
 
     auto cbegin() const noexcept { return threads.cbegin(); }
     auto begin() noexcept { return threads.begin(); }
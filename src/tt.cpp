@@ -18,14 +18,22 @@
 
 #include "tt.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
 
 #include "memory.h"
 #include "misc.h"
+#include "shm.h"
 #include "syzygy/tbprobe.h"
 #include "thread.h"
 
@@ -45,6 +53,10 @@ namespace Stockfish {
 //
 // These fields are in the same order as accessed by TT::probe(), since memory is fastest sequentially.
 // Equally, the store order in save() matches this order.
+//
+// When built with TT_CHECK_ENTRIES, entries carry a further 16 bit checksum of all the
+// other fields. Reads and writes still race, but an entry mixing the fields of different
+// saves (a torn entry) is then detected with high probability, and rejected by probe().
 
 struct TTEntry {
 
@@ -59,6 +71,9 @@ struct TTEntry {
     void save(Key k, Value v, bool pv, Bound b, Depth d, Move m, Value ev, uint8_t generation8);
     // The returned age is a multiple of TranspositionTable::GENERATION_DELTA
     uint8_t relative_age(const uint8_t generation8) const;
+#if defined(TT_CHECK_ENTRIES)
+    uint16_t checksum() const;
+#endif
 
    private:
     friend class TranspositionTable;
@@ -69,8 +84,18 @@ struct TTEntry {
     Move     move16;
     int16_t  value16;
     int16_t  eval16;
+#if defined(TT_CHECK_ENTRIES)
+    uint16_t check16;
+#endif
 };
 
+#if defined(TT_STATS)
+namespace {
+// Set by each searching thread, see TranspositionTable::collect_stats()
+thread_local TTStats* threadStats = nullptr;
+}
+#endif
+
 // `genBound8` is where most of the details are. We use the following constants to manipulate 5 leading generation bits
 // and 3 trailing miscellaneous bits.
 
@@ -93,10 +118,31 @@ bool TTEntry::is_occupied() const { return bool(depth8); }
 void TTEntry::save(
   Key k, Value v, bool pv, Bound b, Depth d, Move m, Value ev, uint8_t generation8) {
 
+#if defined(TT_CHECK_ENTRIES)
+    // Never preserve any part of a torn entry, overwrite it as if it held another position
+    if (check16 != checksum())
+        key16 = ~uint16_t(k);
+#endif
+
     // Preserve the old ttmove if we don't have a new one
     if (m || uint16_t(k) != key16)
         move16 = m;
 
+#if defined(TT_STATS)
+    if (threadStats)
+    {
+        threadStats->writes++;
+        if (uint16_t(k) != key16)
+            ++(is_occupied() ? threadStats->replacedOther : threadStats->filled);
+        else if (b == BOUND_EXACT)
+            threadStats->replacedExact++;
+        else if (d - DEPTH_ENTRY_OFFSET + 2 * pv > depth8 - 4)
+            threadStats->replacedDepth++;
+        else if (relative_age(generation8))
+            threadStats->replacedAge++;
+    }
+#endif
+
     // Overwrite less valuable entries (cheapest checks first)
     if (b == BOUND_EXACT || uint16_t(k) != key16 || d - DEPTH_ENTRY_OFFSET + 2 * pv > depth8 - 4
         || relative_age(generation8))
@@ -110,9 +156,26 @@ void TTEntry::save(
         value16   = int16_t(v);
         eval16    = int16_t(ev);
     }
+
+#if defined(TT_CHECK_ENTRIES)
+    check16 = checksum();
+#endif
 }
 
 
+#if defined(TT_CHECK_ENTRIES)
+// Mixes all the fields, so that changing any of them changes the result with
+// high probability. An all-zero (empty) entry has a zero checksum.
+uint16_t TTEntry::checksum() const {
+    uint64_t data = uint64_t(key16) | uint64_t(depth8) << 16 | uint64_t(genBound8) << 24
+                  | uint64_t(move16.raw()) << 32 | uint64_t(uint16_t(value16)) << 48;
+
+    data = (data ^ (uint64_t(uint16_t(eval16)) << 29)) * 0x9E3779B97F4A7C15ULL;
+    return uint16_t(data >> 48);
+}
+#endif
+
+
 uint8_t TTEntry::relative_age(const uint8_t generation8) const {
     // Due to our packed storage format for generation and its cyclic
     // nature we add GENERATION_CYCLE (256 is the modulus, plus what
@@ -137,6 +200,20 @@ void TTWriter::write(
 // of TTEntry. Each non-empty TTEntry contains information on exactly one position. The size of a Cluster should
 // divide the size of a cache line for best performance, as the cacheline is prefetched when possible.
 
+#if defined(TT_CHECK_ENTRIES)
+
+// With the 12 bytes checked entries, a cluster fills a whole cache line
+static constexpr int ClusterSize = 5;
+
+struct Cluster {
+    TTEntry entry[ClusterSize];
+    char    padding[4];  // Pad to 64 bytes
+};
+
+static_assert(sizeof(Cluster) == 64, "Suboptimal Cluster size");
+
+#else
+
 static constexpr int ClusterSize = 3;
 
 struct Cluster {
@@ -146,16 +223,135 @@ struct Cluster {
 
 static_assert(sizeof(Cluster) == 32, "Suboptimal Cluster size");
 
+#endif
+
+
+// A shared table lives in a named shared memory segment, laid out as a
+// SharedTableHeader followed by the Cluster array. The segment is created
+// zero-filled by the first process attaching to it, and removed when the last
+// one detaches. Entries are written racily by all the processes, exactly as
+// by the threads of a single process. The generation is kept in the segment
+// and advanced by every new_search(), so aging is consistent for all the
+// writers; it merely proceeds faster when several processes are searching.
+
+struct alignas(64) SharedTableHeader {
+    uint64_t clusterCount;
+    uint8_t  generation8;
+};
+
+static_assert(std::atomic<uint8_t>::is_always_lock_free
+                && sizeof(std::atomic<uint8_t>) == sizeof(uint8_t),
+              "The shared generation is accessed in place as an atomic");
+
+#if !defined(_WIN32) && !defined(__ANDROID__)
+
+struct SharedTable {
+    shm::SharedMemory<SharedTableHeader> memory;
+};
+
+void TranspositionTable::attach_shared(const std::string& sharedName) {
+    // Tables of different sizes or layouts must never map the same segment
+    const std::string key =
+      sharedName + "$" + std::to_string(clusterCount) + "$" + std::to_string(sizeof(Cluster));
+    const std::string name = "/sf_tt_" + std::to_string(std::hash<std::string>{}(key));
+
+    auto memory = shm::create_shared<SharedTableHeader>(name, SharedTableHeader{clusterCount, 0},
+                                                        clusterCount * sizeof(Cluster));
+
+    if (!memory || memory->get().clusterCount != clusterCount)
+        return;
+
+    auto* header = static_cast<SharedTableHeader*>(memory->data());
+
+    #if defined(MADV_HUGEPAGE)
+    madvise(header, sizeof(SharedTableHeader) + clusterCount * sizeof(Cluster), MADV_HUGEPAGE);
+    #endif
+
+    shared      = std::make_unique<SharedTable>(SharedTable{std::move(*memory)});
+    table       = reinterpret_cast<Cluster*>(header + 1);
+    generation8 = reinterpret_cast<std::atomic<uint8_t>*>(&header->generation8);
+}
+
+#else
+
+// Shared memory is not supported, so the table always stays private
+struct SharedTable {};
+
+void TranspositionTable::attach_shared(const std::string&) {}
+
+#endif
+
+
+TranspositionTable::TranspositionTable() = default;
+
+TranspositionTable::~TranspositionTable() { free_table(); }
+
+
+void TranspositionTable::free_table() {
+    if (shared)
+        shared.reset();
+    else if (lazyBytes)
+        lazy_zeroed_free(table, lazyBytes);
+    else
+        aligned_large_pages_free(table);
+
+    table       = nullptr;
+    lazyBytes   = 0;
+    generation8 = &localGeneration8;
+    sliceNodes.clear();
+}
+
+
+bool TranspositionTable::is_shared() const { return shared != nullptr; }
+
 
 // Sets the size of the transposition table,
 // measured in megabytes. Transposition table consists
 // of clusters and each cluster consists of ClusterSize number of TTEntry.
-void TranspositionTable::resize(size_t mbSize, ThreadPool& threads) {
-    aligned_large_pages_free(table);
+// If a shared table is requested but can't be attached, a private one is used.
+// A private table keeps its memory when its size does not change, and its most
+// valuable entries when it shrinks by an integer factor. Otherwise, as when its
+// size does not change, it starts empty.
+void TranspositionTable::resize(size_t mbSize, ThreadPool& threads, const std::string& sharedName) {
+    const size_t newClusterCount = mbSize * 1024 * 1024 / sizeof(Cluster);
+
+    const bool keep = table && !shared && sharedName.empty();
+
+    if (keep && newClusterCount == clusterCount)
+    {
+        clear(threads);
+        return;
+    }
+
+    const Cluster* oldTable        = nullptr;
+    const size_t   oldClusterCount = clusterCount;
+    const size_t   oldLazyBytes    = lazyBytes;
+
+    if (keep && clusterCount % newClusterCount == 0)
+    {
+        oldTable  = table;
+        table     = nullptr;
+        lazyBytes = 0;
+    }
+    else
+        free_table();
+
+    clusterCount = newClusterCount;
+
+    if (!sharedName.empty())
+        attach_shared(sharedName);
+
+    if (shared)
+        return;
 
-    clusterCount = mbSize * 1024 * 1024 / sizeof(Cluster);
+    // Prefer fresh pages, so that the table is zeroed on first touch rather
+    // than upfront, and the time to resize does not grow with its size.
+    const size_t size = clusterCount * sizeof(Cluster);
 
-    table = static_cast<Cluster*>(aligned_large_pages_alloc(clusterCount * sizeof(Cluster)));
+    if ((table = static_cast<Cluster*>(lazy_zeroed_alloc(size))))
+        lazyBytes = size;
+    else
+        table = static_cast<Cluster*>(aligned_large_pages_alloc(size));
 
     if (!table)
     {
@@ -163,26 +359,123 @@ void TranspositionTable::resize(size_t mbSize, ThreadPool& threads) {
         exit(EXIT_FAILURE);
     }
 
-    clear(threads);
+    if (!oldTable)
+    {
+        clear(threads);
+        return;
+    }
+
+    place_slices(threads);
+    rehash(oldTable, oldClusterCount, threads);
+
+    if (oldLazyBytes)
+        lazy_zeroed_free(const_cast<Cluster*>(oldTable), oldLazyBytes);
+    else
+        aligned_large_pages_free(const_cast<Cluster*>(oldTable));
+}
+
+
+// Moves the entries of a table an integer number of times larger into this one.
+// Old clusters ratio * i to ratio * i + ratio - 1 hold exactly the keys which
+// map to the new cluster i, of which the most valuable entries are kept, as
+// measured for replacement in probe().
+void TranspositionTable::rehash(const Cluster* oldTable,
+                                size_t         oldClusterCount,
+                                ThreadPool&    threads) {
+
+    const size_t  ratio = oldClusterCount / clusterCount;
+    const uint8_t gen8  = generation();
+
+    auto worth = [gen8](const TTEntry& e) {
+        return e.is_occupied() ? e.depth8 - e.relative_age(gen8) : std::numeric_limits<int>::min();
+    };
+
+    run_on_slices(threads, [&](size_t, size_t start, size_t len) {
+        for (size_t i = start; i < start + len; ++i)
+        {
+            TTEntry* const tte = table[i].entry;
+            std::memset(&table[i], 0, sizeof(Cluster));
+
+            for (size_t j = ratio * i; j < ratio * (i + 1); ++j)
+                for (const TTEntry& e : oldTable[j].entry)
+                {
+                    // Never keep two entries for the same key16, as probe() would
+                    // only ever find the first one.
+                    TTEntry* replace = std::find_if(tte, tte + ClusterSize, [&](const TTEntry& t) {
+                        return t.is_occupied() && t.key16 == e.key16;
+                    });
+
+                    if (replace == tte + ClusterSize)
+                        replace = std::min_element(
+                          tte, tte + ClusterSize,
+                          [&](const TTEntry& a, const TTEntry& b) { return worth(a) < worth(b); });
+
+                    if (worth(e) > worth(*replace))
+                        *replace = e;
+                }
+        }
+    });
 }
 
 
 // Initializes the entire transposition table to zero,
-// in a multi-threaded way.
+// in a multi-threaded way. A shared table is left untouched,
+// as other processes may still be using it.
 void TranspositionTable::clear(ThreadPool& threads) {
-    generation8              = 0;
+    if (shared)
+        return;
+
+    generation8->store(0, std::memory_order_relaxed);
+    rejectedProbes = 0;
+
+    // Unless the threads are bound to several NUMA nodes, let the OS zero the
+    // pages as they get touched again during the search.
+    place_slices(threads);
+
+    if (lazyBytes && sliceNodes.empty() && lazy_zero(table, lazyBytes))
+        return;
+
+    run_on_slices(threads, [this](size_t, size_t start, size_t len) {
+        std::memset(&table[start], 0, len * sizeof(Cluster));
+    });
+}
+
+
+// The memory is committed on first touch, so each slice of the table is placed
+// on the NUMA node of the thread that zeroes it. This records the node of each
+// slice when the threads are bound to more than one node, to tell how many TT
+// probes go to local memory. Otherwise the nodes are not recorded.
+void TranspositionTable::place_slices(ThreadPool& threads) {
+    const auto& threadNodes = threads.get_bound_thread_numa_nodes();
+
+    sliceNodes.clear();
+
+    if (threadNodes.size() == threads.num_threads()
+        && std::any_of(threadNodes.begin(), threadNodes.end(),
+                       [&](size_t node) { return node != threadNodes[0]; }))
+        sliceNodes.assign(threadNodes.begin(), threadNodes.end());
+}
+
+
+size_t TranspositionTable::numa_node_of(const Key key) const {
+    const size_t stride = clusterCount / sliceNodes.size();
+    return sliceNodes[std::min(mul_hi64(key, clusterCount) / stride, sliceNodes.size() - 1)];
+}
+
+
+// Runs job(idx, start, len) on every thread, each with its own slice of the table
+void TranspositionTable::run_on_slices(
+  ThreadPool& threads, const std::function<void(size_t, size_t, size_t)>& job) const {
+
     const size_t threadCount = threads.num_threads();
 
     for (size_t i = 0; i < threadCount; ++i)
     {
-        threads.run_on_thread(i, [this, i, threadCount]() {
-            // Each thread will zero its part of the hash table
-            const size_t stride = clusterCount / threadCount;
-            const size_t start  = stride * i;
-            const size_t len    = i + 1 != threadCount ? stride : clusterCount - start;
-
-            std::memset(&table[start], 0, len * sizeof(Cluster));
-        });
+        const size_t stride = clusterCount / threadCount;
+        const size_t start  = stride * i;
+        const size_t len    = i + 1 != threadCount ? stride : clusterCount - start;
+
+        threads.run_on_thread(i, [&job, i, start, len]() { job(i, start, len); });
     }
 
     for (size_t i = 0; i < threadCount; ++i)
@@ -194,12 +487,13 @@ void TranspositionTable::clear(ThreadPool& threads) {
 // occupation during a search. The hash is x permill full, as per UCI protocol.
 // Only counts entries which match the current generation.
 int TranspositionTable::hashfull(int maxAge) const {
-    int maxAgeInternal = maxAge << GENERATION_BITS;
-    int cnt            = 0;
+    const uint8_t gen8           = generation();
+    int           maxAgeInternal = maxAge << GENERATION_BITS;
+    int           cnt            = 0;
     for (int i = 0; i < 1000; ++i)
         for (int j = 0; j < ClusterSize; ++j)
             cnt += table[i].entry[j].is_occupied()
-                && table[i].entry[j].relative_age(generation8) <= maxAgeInternal;
+                && table[i].entry[j].relative_age(gen8) <= maxAgeInternal;
 
     return cnt / ClusterSize;
 }
@@ -207,11 +501,75 @@ int TranspositionTable::hashfull(int maxAge) const {
 
 void TranspositionTable::new_search() {
     // increment by delta to keep lower bits as is
-    generation8 += GENERATION_DELTA;
+    generation8->fetch_add(GENERATION_DELTA, std::memory_order_relaxed);
+}
+
+
+uint8_t TranspositionTable::generation() const {
+    return generation8->load(std::memory_order_relaxed);
+}
+
+
+uint64_t TranspositionTable::rejected_probes() const {
+    return rejectedProbes.load(std::memory_order_relaxed);
+}
+
+
+TTStats& TTStats::operator+=(const TTStats& s) {
+    probes += s.probes;
+    hits += s.hits;
+    collisions += s.collisions;
+    writes += s.writes;
+    filled += s.filled;
+    replacedOther += s.replacedOther;
+    replacedExact += s.replacedExact;
+    replacedDepth += s.replacedDepth;
+    replacedAge += s.replacedAge;
+    return *this;
+}
+
+
+// Makes the probes and writes of the calling thread count in `stats`. Without
+// TT_STATS nothing is counted, and the hot paths are left untouched.
+void TranspositionTable::collect_stats([[maybe_unused]] TTStats* stats) {
+#if defined(TT_STATS)
+    threadStats = stats;
+#endif
 }
 
 
-uint8_t TranspositionTable::generation() const { return generation8; }
+// Walks all the entries, unlike hashfull() which only samples the first clusters
+TTOccupancy TranspositionTable::occupancy(ThreadPool& threads) const {
+    const uint8_t            gen8 = generation();
+    std::vector<TTOccupancy> parts(threads.num_threads());
+
+    run_on_slices(threads, [this, gen8, &parts](size_t i, size_t start, size_t len) {
+        TTOccupancy& o = parts[i];
+
+        for (size_t c = start; c < start + len; ++c)
+            for (const TTEntry& e : table[c].entry)
+                if (e.is_occupied())
+                {
+                    o.used++;
+                    o.depth[e.depth8]++;
+                    o.age[e.relative_age(gen8) >> GENERATION_BITS]++;
+                }
+    });
+
+    TTOccupancy total;
+    total.entries = clusterCount * ClusterSize;
+
+    for (const TTOccupancy& o : parts)
+    {
+        total.used += o.used;
+        for (size_t d = 0; d < total.depth.size(); ++d)
+            total.depth[d] += o.depth[d];
+        for (size_t a = 0; a < total.age.size(); ++a)
+            total.age[a] += o.age[a];
+    }
+
+    return total;
+}
 
 
 // Looks up the current position in the transposition
@@ -227,17 +585,51 @@ std::tuple<bool, TTData, TTWriter> TranspositionTable::probe(const Key key) cons
 
     for (int i = 0; i < ClusterSize; ++i)
         if (tte[i].key16 == key16)
+        {
+#if defined(TT_STATS)
+            if (threadStats)
+            {
+                threadStats->probes++;
+                threadStats->hits += tte[i].is_occupied();
+            }
+#endif
+#if defined(TT_CHECK_ENTRIES)
+            // Validate a private copy, so that the returned data is exactly the checked
+            // data. Rejected entries are reported as misses, and replaced on the next write.
+            const TTEntry copy = tte[i];
+            if (copy.check16 != copy.checksum())
+            {
+                rejectedProbes.fetch_add(1, std::memory_order_relaxed);
+                return {false,
+                        TTData{Move::none(), VALUE_NONE, VALUE_NONE, DEPTH_ENTRY_OFFSET, BOUND_NONE,
+                               false},
+                        TTWriter(&tte[i])};
+            }
+            return {copy.is_occupied(), copy.read(), TTWriter(&tte[i])};
+#else
             // This gap is the main place for read races.
             // After `read()` completes that copy is final, but may be self-inconsistent.
             return {tte[i].is_occupied(), tte[i].read(), TTWriter(&tte[i])};
+#endif
+        }
 
     // Find an entry to be replaced according to the replacement strategy
-    TTEntry* replace = tte;
+    const uint8_t gen8    = generation();
+    TTEntry*      replace = tte;
     for (int i = 1; i < ClusterSize; ++i)
-        if (replace->depth8 - replace->relative_age(generation8)
-            > tte[i].depth8 - tte[i].relative_age(generation8))
+        if (replace->depth8 - replace->relative_age(gen8)
+            > tte[i].depth8 - tte[i].relative_age(gen8))
             replace = &tte[i];
 
+#if defined(TT_STATS)
+    // A write for this position would evict another one
+    if (threadStats)
+    {
+        threadStats->probes++;
+        threadStats->collisions += replace->is_occupied();
+    }
+#endif
+
     return {false,
             TTData{Move::none(), VALUE_NONE, VALUE_NONE, DEPTH_ENTRY_OFFSET, BOUND_NONE, false},
             TTWriter(replace)};
@@ -248,4 +640,97 @@ TTEntry* TranspositionTable::first_entry(const Key key) const {
     return &table[mul_hi64(key, clusterCount)].entry[0];
 }
 
+
+// A dumped table is a TTFileHeader followed by the raw Cluster array. The header
+// records the layout of the writing binary, so that a dump is only ever loaded
+// into a table of the same size by an engine with the same entry format.
+namespace {
+
+constexpr char     TTFileMagic[8] = "SF-TT";
+constexpr uint32_t TTFileVersion  = 1;
+
+struct TTFileHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t entrySize;
+    uint32_t entriesPerCluster;
+    uint32_t clusterSize;
+    uint32_t generation8;
+    uint64_t clusterCount;
+};
+
+TTFileHeader make_header(size_t clusterCount, uint8_t generation8) {
+    TTFileHeader h{};
+    std::memcpy(h.magic, TTFileMagic, sizeof(TTFileMagic));
+    h.version           = TTFileVersion;
+    h.byteOrder         = 0x01020304;
+    h.entrySize         = sizeof(TTEntry);
+    h.entriesPerCluster = ClusterSize;
+    h.clusterSize       = sizeof(Cluster);
+    h.generation8       = generation8;
+    h.clusterCount      = clusterCount;
+    return h;
+}
+
+}
+
+
+// Writes the header and the whole cluster array to the given file.
+// Must not be called during a search.
+bool TranspositionTable::save(const std::string& filename) const {
+    std::ofstream stream(filename, std::ios::binary);
+    TTFileHeader  h = make_header(clusterCount, generation());
+
+    stream.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    stream.write(reinterpret_cast<const char*>(table),
+                 std::streamsize(clusterCount * sizeof(Cluster)));
+
+    return bool(stream);
+}
+
+
+// Reads back a table written by save(). The header must match the current table
+// size and entry layout, otherwise the table is left untouched. The payload is read
+// in parallel, each thread filling the same slice it zeroes in clear(), so that
+// memory is first touched on the NUMA node of the thread using it.
+bool TranspositionTable::load(const std::string& filename, ThreadPool& threads) {
+    std::ifstream stream(filename, std::ios::binary);
+    TTFileHeader  h{};
+    TTFileHeader  expected = make_header(clusterCount, 0);
+
+    stream.read(reinterpret_cast<char*>(&h), sizeof(h));
+
+    if (!stream || std::memcmp(h.magic, expected.magic, sizeof(h.magic))
+        || h.version != expected.version || h.byteOrder != expected.byteOrder
+        || h.entrySize != expected.entrySize || h.entriesPerCluster != expected.entriesPerCluster
+        || h.clusterSize != expected.clusterSize || h.clusterCount != expected.clusterCount)
+        return false;
+
+    stream.seekg(0, std::ios::end);
+    if (size_t(stream.tellg()) != sizeof(h) + clusterCount * sizeof(Cluster))
+        return false;
+
+    std::vector<char> ok(threads.num_threads(), false);
+
+    // Each thread will read its part of the hash table
+    run_on_slices(threads, [this, &filename, &ok](size_t i, size_t start, size_t len) {
+        std::ifstream part(filename, std::ios::binary);
+        part.seekg(std::streamoff(sizeof(TTFileHeader) + start * sizeof(Cluster)));
+        part.read(reinterpret_cast<char*>(&table[start]), std::streamsize(len * sizeof(Cluster)));
+        ok[i] = bool(part);
+    });
+
+    // A partially read table is still a valid (if inconsistent) table, but
+    // don't leave it behind as if the load had succeeded.
+    if (std::find(ok.begin(), ok.end(), false) != ok.end())
+    {
+        clear(threads);
+        return false;
+    }
+
+    generation8->store(uint8_t(h.generation8), std::memory_order_relaxed);
+    return true;
+}
+
 }  // namespace Stockfish
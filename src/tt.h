@@ -19,9 +19,15 @@
 #ifndef TT_H_INCLUDED
 #define TT_H_INCLUDED
 
+#include <array>
+#include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
 #include <tuple>
+#include <vector>
 
 #include "memory.h"
 #include "types.h"
@@ -31,6 +37,7 @@ namespace Stockfish {
 class ThreadPool;
 struct TTEntry;
 struct Cluster;
+struct SharedTable;
 
 // There is only one global hash table for the engine and all its threads. For chess in particular, we even allow racy
 // updates between threads to and from the TT, as taking the time to synchronize access would cost thinking time and
@@ -78,13 +85,36 @@ struct TTWriter {
 };
 
 
+// Probe and write counters of one thread, only gathered when built with TT_STATS.
+// A write overwrites the entry because it was empty or held another position, or else
+// because of the first of the exact bound, depth and age conditions that is met.
+struct TTStats {
+    uint64_t probes = 0, hits = 0, collisions = 0;
+    uint64_t writes = 0, filled = 0, replacedOther = 0;
+    uint64_t replacedExact = 0, replacedDepth = 0, replacedAge = 0;
+
+    TTStats& operator+=(const TTStats& s);
+};
+
+
+// A full scan of the table, by stored depth and by age in generations
+struct TTOccupancy {
+    uint64_t                  entries = 0, used = 0;
+    std::array<uint64_t, 256> depth{};  // Indexed by depth - DEPTH_ENTRY_OFFSET
+    std::array<uint64_t, 32>  age{};
+};
+
+
 class TranspositionTable {
 
    public:
-    ~TranspositionTable() { aligned_large_pages_free(table); }
+    TranspositionTable();
+    ~TranspositionTable();
 
-    void resize(size_t mbSize, ThreadPool& threads);  // Set TT size
-    void clear(ThreadPool& threads);                  // Re-initialize memory, multithreaded
+    // Set TT size, optionally placing the table in a shared memory segment of the given name
+    void resize(size_t mbSize, ThreadPool& threads, const std::string& sharedName = "");
+    void clear(ThreadPool& threads);  // Re-initialize memory, multithreaded
+    bool is_shared() const;           // Whether other processes may use this table as well
     int  hashfull(int maxAge = 0)
       const;  // Approximate what fraction of entries (permille) have been written to during this root search
 
@@ -96,13 +126,42 @@ class TranspositionTable {
     TTEntry* first_entry(const Key key)
       const;  // This is the hash function; its only external use is memory prefetching.
 
+    uint64_t rejected_probes() const;  // Torn entries detected, only with TT_CHECK_ENTRIES
+
+    static void collect_stats(TTStats* stats);         // Counters of the calling thread, with TT_STATS
+    TTOccupancy occupancy(ThreadPool& threads) const;  // Scan the whole table, multithreaded
+
+    // Whether the NUMA node holding each slice of the table is known, see clear()
+    bool   numa_placed() const { return !sliceNodes.empty(); }
+    size_t numa_node_of(const Key key) const;  // The NUMA node whose slice holds the key
+
+    bool save(const std::string& filename) const;                 // Dump the table to disk
+    bool load(const std::string& filename, ThreadPool& threads);  // Restore a dumped table
+
    private:
     friend struct TTEntry;
 
-    size_t   clusterCount;
-    Cluster* table = nullptr;
+    void   attach_shared(const std::string& sharedName);
+    void   free_table();
+    void   rehash(const Cluster* oldTable, size_t oldClusterCount, ThreadPool& threads);
+    void   place_slices(ThreadPool& threads);
+    void   run_on_slices(ThreadPool&                                         threads,
+                         const std::function<void(size_t, size_t, size_t)>& job) const;
+
+    size_t                       clusterCount;
+    Cluster*                     table = nullptr;
+    std::unique_ptr<SharedTable> shared;  // Owns the mapping when the table is shared
+    size_t                       lazyBytes = 0;  // Size of a table from lazy_zeroed_alloc()
+
+    std::vector<size_t> sliceNodes;  // The NUMA node of the thread of each slice, if bound
+
+    // Size must be not bigger than TTEntry::genBound8. For a shared table this points
+    // into the segment, so that all the attached processes age entries consistently.
+    std::atomic<uint8_t>  localGeneration8{0};
+    std::atomic<uint8_t>* generation8 = &localGeneration8;
 
-    uint8_t generation8 = 0;  // Size must be not bigger than TTEntry::genBound8
+    // Only updated on the rare rejections, so a single counter does not cause contention
+    mutable std::atomic<uint64_t> rejectedProbes{0};
 };
 
 }  // namespace Stockfish
@@ -21,11 +21,17 @@
 #include <algorithm>
 #include <cctype>
 #include <cmath>
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
+#include <fstream>
+#include <iomanip>
 #include <iterator>
+#include <mutex>
 #include <optional>
 #include <sstream>
 #include <string_view>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -41,7 +47,11 @@
 
 namespace Stockfish {
 
-constexpr auto BenchmarkCommand = "speedtest";
+constexpr auto BenchmarkCommand   = "speedtest";
+constexpr auto ScalingCommand     = "scalingtest";
+constexpr auto EvalSpeedCommand   = "evalspeedtest";
+constexpr auto KernelCommand      = "kerneltune";
+constexpr auto AccumulatorCommand = "accumulatorbench";
 
 constexpr auto StartFEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
 template<typename... Ts>
@@ -52,6 +62,117 @@ struct overload: Ts... {
 template<typename... Ts>
 overload(Ts...) -> overload<Ts...>;
 
+namespace {
+
+// Quotes a string for JSON output, escaping the characters that require it
+std::string json_string(std::string_view str) {
+    std::string quoted = "\"";
+
+    for (char c : str)
+        if (c == '"' || c == '\\')
+            quoted += std::string("\\") + c;
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            std::stringstream ss;
+            ss << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c);
+            quoted += ss.str();
+        }
+        else
+            quoted += c;
+
+    return quoted + "\"";
+}
+
+// Turns space separated words, like the moves of a PV, into a JSON array
+std::string json_array(std::string_view words, bool quoted) {
+    std::string array;
+
+    for (auto& word : split(words, " "))
+        if (!word.empty())
+            array += (array.empty() ? "" : ",") + (quoted ? json_string(word) : std::string(word));
+
+    return "[" + array + "]";
+}
+
+// Turns a score into {"cp":<x>} or {"mate":<y>}, as in UCIEngine::format_score()
+std::string json_score(const Score& s) {
+    std::string score = UCIEngine::format_score(s);
+    size_t      space = score.find(' ');
+
+    return "{" + json_string(score.substr(0, space)) + ":" + score.substr(space + 1) + "}";
+}
+
+// The fields of a JSON record with the content of an "info ... pv ..." line
+std::string json_info(const Engine::InfoFull& info) {
+    std::stringstream ss;
+
+    ss << "\"depth\":" << info.depth                //
+       << ",\"seldepth\":" << info.selDepth         //
+       << ",\"multipv\":" << info.multiPV           //
+       << ",\"score\":" << json_score(info.score);  //
+
+    if (!info.bound.empty())
+        ss << ",\"bound\":" << json_string(info.bound);
+
+    if (!info.wdl.empty())
+        ss << ",\"wdl\":" << json_array(info.wdl, false);
+
+    ss << ",\"nodes\":" << info.nodes               //
+       << ",\"nps\":" << info.nps                   //
+       << ",\"hashfull\":" << info.hashfull         //
+       << ",\"tbhits\":" << info.tbHits             //
+       << ",\"time\":" << info.timeMs               //
+       << ",\"pv\":" << json_array(info.pv, true);  //
+
+    return ss.str();
+}
+
+#if defined(NNUE_PROFILE)
+// The time spent per evaluation in each stage of both nets, with its share of the
+// whole, and the density of the sparse input of their first layer
+std::string format_nnue_profile(const Eval::NNUE::EvalProfile& profile) {
+    using namespace Eval::NNUE;
+
+    constexpr const char* Stages[PROFILE_STAGE_NB] = {
+      "feature transform      : ", "fc_0 sparse affine     : ", "ac_sqr_0 sqr clipped   : ",
+      "ac_0 clipped relu      : ", "fc_1 affine            : ", "ac_1 clipped relu      : ",
+      "fc_2 affine            : "};
+
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1);
+
+    #if defined(NNUE_PROFILE_TSC)
+    ss << "Layer timings              : time stamp counter cycles";
+    #else
+    ss << "Layer timings              : nanoseconds";
+    #endif
+
+    for (const auto& [label, net] : {std::pair{"\nBig net evaluations        : ", &profile.big},
+                                     std::pair{"\nSmall net evaluations      : ", &profile.small}})
+    {
+        uint64_t total = 0;
+        for (uint64_t t : net->ticks)
+            total += t;
+
+        const uint64_t evals = std::max(net->evals, uint64_t(1));
+
+        ss << label << net->evals;
+
+        for (int i = 0; i < PROFILE_STAGE_NB; ++i)
+            ss << "\n    " << Stages[i] << double(net->ticks[i]) / evals << " per eval ("
+               << (total ? 100.0 * net->ticks[i] / total : 0.0) << "%)";
+
+        ss << "\n    nonzero input chunks   : " << double(net->nnzChunks) / evals << " of "
+           << net->inputChunks / evals << " ("
+           << (net->inputChunks ? 100.0 * net->nnzChunks / net->inputChunks : 0.0) << "%)";
+    }
+
+    return ss.str();
+}
+#endif
+
+}  // namespace
+
 void UCIEngine::print_info_string(std::string_view str) {
     sync_cout_start();
     for (auto& line : split(str, "\n"))
@@ -77,11 +198,21 @@ UCIEngine::UCIEngine(int argc, char** argv) :
 }
 
 void UCIEngine::init_search_update_listeners() {
-    engine.set_on_iter([](const auto& i) { on_iter(i); });
-    engine.set_on_update_no_moves([](const auto& i) { on_update_no_moves(i); });
-    engine.set_on_update_full(
-      [this](const auto& i) { on_update_full(i, engine.get_options()["UCI_ShowWDL"]); });
-    engine.set_on_bestmove([](const auto& bm, const auto& p) { on_bestmove(bm, p); });
+    // The output format is looked up on each update, so that it can be changed between searches
+    auto json = [this] { return engine.get_options()["InfoFormat"] == "json"; };
+
+    engine.set_on_iter([json](const auto& i) { json() ? on_iter_json(i) : on_iter(i); });
+    engine.set_on_update_no_moves([json](const auto& i) {
+        json() ? on_update_no_moves_json(i) : on_update_no_moves(i);
+    });
+    engine.set_on_update_full([this, json](const auto& i) {
+        json() ? on_update_full_json(i) : on_update_full(i, engine.get_options()["UCI_ShowWDL"]);
+    });
+    engine.set_on_bestmove([json](const auto& bm, const auto& p) {
+        json() ? on_bestmove_json(bm, p) : on_bestmove(bm, p);
+    });
+    engine.set_on_root_probe(
+      [json](const auto& i) { json() ? on_root_probe_json(i) : on_root_probe(i); });
     engine.set_on_verify_networks([](const auto& s) { print_info_string(s); });
 }
 
@@ -144,6 +275,14 @@ void UCIEngine::loop() {
             bench(is);
         else if (token == BenchmarkCommand)
             benchmark(is);
+        else if (token == ScalingCommand)
+            scaling(is);
+        else if (token == EvalSpeedCommand)
+            eval_speed(is);
+        else if (token == KernelCommand)
+            tune_kernels(is);
+        else if (token == AccumulatorCommand)
+            accumulator_bench(is);
         else if (token == "d")
             sync_cout << engine.visualize() << sync_endl;
         else if (token == "eval")
@@ -162,6 +301,52 @@ void UCIEngine::loop() {
 
             engine.save_network(files);
         }
+        else if (token == "export_net_compressed")
+        {
+            std::pair<std::optional<std::string>, std::string> files[2];
+
+            if (is >> std::skipws >> files[0].second)
+                files[0].first = files[0].second;
+
+            if (is >> std::skipws >> files[1].second)
+                files[1].first = files[1].second;
+
+            engine.save_network(files, true);
+        }
+        else if (token == "tt_stats")
+            tt_stats();
+        else if (token == "accumulator_stats")
+            accumulator_stats();
+        else if (token == "nnue_profile")
+            nnue_profile();
+        else if (token == "tb_cache_stats")
+            tb_cache_stats();
+        else if (token == "batch")
+        {
+            if (batch(is))
+                token = "quit";  // Read as part of the batch input
+        }
+        else if (token == "export_tt")
+        {
+            std::string file;
+            is >> std::skipws >> file;
+
+            const bool saved = engine.save_tt(file);
+            sync_cout << (saved ? "Transposition table saved successfully to " + file
+                                : "Failed to export the transposition table")
+                      << sync_endl;
+        }
+        else if (token == "import_tt")
+        {
+            std::string file;
+            is >> std::skipws >> file;
+
+            const bool loaded = engine.load_tt(file);
+            sync_cout << (loaded ? "Transposition table loaded successfully from " + file
+                                 : "Failed to import the transposition table. The file must be "
+                                   "exported by a compatible binary with the same Hash size.")
+                      << sync_endl;
+        }
         else if (token == "--help" || token == "help" || token == "--license" || token == "license")
             sync_cout
               << "\nStockfish is a powerful chess engine for playing and analyzing."
@@ -229,7 +414,7 @@ void UCIEngine::go(std::istringstream& is) {
 
 void UCIEngine::bench(std::istream& args) {
     std::string token;
-    uint64_t    num, nodes = 0, cnt = 1;
+    uint64_t    num;
     uint64_t    nodesSearched = 0;
     const auto& options       = engine.get_options();
 
@@ -243,57 +428,94 @@ void UCIEngine::bench(std::istream& args) {
     num = count_if(list.begin(), list.end(),
                    [](const std::string& s) { return s.find("go ") == 0 || s.find("eval") == 0; });
 
-    TimePoint elapsed = now();
-
-    for (const auto& cmd : list)
-    {
-        std::istringstream is(cmd);
-        is >> std::skipws >> token;
+    // Runs the commands, returning the nodes searched and the time taken
+    auto run = [&]() {
+        uint64_t  nodes   = 0;
+        uint64_t  cnt     = 1;
+        TimePoint elapsed = now();
 
-        if (token == "go" || token == "eval")
+        for (const auto& cmd : list)
         {
-            std::cerr << "\nPosition: " << cnt++ << '/' << num << " (" << engine.fen() << ")"
-                      << std::endl;
-            if (token == "go")
-            {
-                Search::LimitsType limits = parse_limits(is);
+            std::istringstream is(cmd);
+            is >> std::skipws >> token;
 
-                if (limits.perft)
-                    nodesSearched = perft(limits);
-                else
+            if (token == "go" || token == "eval")
+            {
+                std::cerr << "\nPosition: " << cnt++ << '/' << num << " (" << engine.fen() << ")"
+                          << std::endl;
+                if (token == "go")
                 {
-                    engine.go(limits);
-                    engine.wait_for_search_finished();
+                    Search::LimitsType limits = parse_limits(is);
+
+                    if (limits.perft)
+                        nodesSearched = perft(limits);
+                    else
+                    {
+                        engine.go(limits);
+                        engine.wait_for_search_finished();
+                    }
+
+                    nodes += nodesSearched;
+                    nodesSearched = 0;
                 }
-
-                nodes += nodesSearched;
-                nodesSearched = 0;
+                else
+                    engine.trace_eval();
+            }
+            else if (token == "setoption")
+                setoption(is);
+            else if (token == "position")
+                position(is);
+            else if (token == "ucinewgame")
+            {
+                engine.search_clear();  // search_clear may take a while
+                elapsed = now();
             }
-            else
-                engine.trace_eval();
-        }
-        else if (token == "setoption")
-            setoption(is);
-        else if (token == "position")
-            position(is);
-        else if (token == "ucinewgame")
-        {
-            engine.search_clear();  // search_clear may take a while
-            elapsed = now();
         }
-    }
 
-    elapsed = now() - elapsed + 1;  // Ensure positivity to avoid a 'divide by zero'
+        // Ensure positivity to avoid a 'divide by zero'
+        return std::make_pair(nodes, now() - elapsed + 1);
+    };
+
+    const uint64_t tbMappingWait    = engine.get_tb_mapping_wait();
+    const auto [nodes, elapsed]     = run();
+    const uint64_t tbMappingWaitEnd = engine.get_tb_mapping_wait();
+    const size_t   threatRows       = engine.get_threat_weight_rows();
 
     dbg_print();
 
-    std::cerr << "\n==========================="    //
-              << "\nTotal time (ms) : " << elapsed  //
-              << "\nNodes searched  : " << nodes    //
-              << "\nNodes/second    : " << 1000 * nodes / elapsed << std::endl;
+    std::cerr << "\n==========================="                   //
+              << "\nTotal time (ms) : " << elapsed                 //
+              << "\nNodes searched  : " << nodes                   //
+              << "\nNodes/second    : " << 1000 * nodes / elapsed  //
+              << "\nThreat rows     : " << threatRows << std::endl;
+
+    // With a network saved by export_net_compressed the threat features share rows.
+    // Search again with one row per feature, which must give the same nodes.
+    if (engine.shares_threat_rows())
+    {
+        engine.share_threat_rows(false);
+        const auto [regularNodes, regularElapsed] = run();
+        engine.share_threat_rows(true);
+
+        std::cerr << "Regular rows    : " << 1000 * regularNodes / regularElapsed
+                  << " nodes/second, " << regularNodes << " nodes searched" << std::endl;
+    }
+
+#if defined(TT_CHECK_ENTRIES)
+    std::cerr << "TT rejected     : " << engine.get_tt_rejected_probes() << std::endl;
+#endif
+
+    // Time the searching threads were stalled by the first probes of each table
+    if (Tablebases::MaxCardinality)
+        std::cerr << "TB wait (ms)    : " << (tbMappingWaitEnd - tbMappingWait) / 1000.0
+                  << std::endl;
+
+#if defined(NNUE_PROFILE)
+    std::cerr << "\n" << format_nnue_profile(engine.get_nnue_profile()) << std::endl;
+#endif
 
     // reset callback, to not capture a dangling reference to nodesSearched
-    engine.set_on_update_full([&](const auto& i) { on_update_full(i, options["UCI_ShowWDL"]); });
+    init_search_update_listeners();
 }
 
 void UCIEngine::benchmark(std::istream& args) {
@@ -378,6 +600,8 @@ void UCIEngine::benchmark(std::istream& args) {
 
     engine.search_clear();  // search_clear may take a while
 
+    const uint64_t tbMappingWait = engine.get_tb_mapping_wait();
+
     for (const auto& cmd : setup.commands)
     {
         std::istringstream is(cmd);
@@ -451,9 +675,463 @@ void UCIEngine::benchmark(std::istream& args) {
 
     // clang-format on
 
+#if defined(TT_CHECK_ENTRIES)
+    std::cerr << "TT rejected probes         : " << engine.get_tt_rejected_probes() << std::endl;
+#endif
+
+    if (Tablebases::MaxCardinality)
+        std::cerr << "TB mapping wait [ms]       : "
+                  << (engine.get_tb_mapping_wait() - tbMappingWait) / 1000.0 << std::endl;
+
     init_search_update_listeners();
 }
 
+// Compares how Lazy SMP and the root move split scheduler scale with the number of
+// threads, from the time to search a set of positions to a fixed depth. Each run
+// starts from a cleared TT and cleared histories.
+void UCIEngine::scaling(std::istream& args) {
+    uint64_t nodesSearched = 0;
+
+    engine.set_on_update_full([&](const Engine::InfoFull& i) { nodesSearched = i.nodes; });
+
+    engine.set_on_iter([](const auto&) {});
+    engine.set_on_update_no_moves([](const auto&) {});
+    engine.set_on_bestmove([](const auto&, const auto&) {});
+    engine.set_on_verify_networks([](const auto&) {});
+
+    Benchmark::ScalingSetup setup     = Benchmark::setup_scaling(args);
+    const bool              rootSplit = engine.get_options()["RootSplit"];
+
+    auto ss = std::istringstream("name Hash value " + std::to_string(setup.ttSize));
+    setoption(ss);
+
+    // Runs all the searches, returning the total time in ms and the nodes searched
+    auto run = [&](int threads, bool split) {
+        auto opt = std::istringstream("name Threads value " + std::to_string(threads));
+        setoption(opt);
+        opt = std::istringstream(std::string("name RootSplit value ") + (split ? "true" : "false"));
+        setoption(opt);
+
+        engine.search_clear();
+
+        TimePoint time  = 0;
+        uint64_t  nodes = 0;
+        size_t    cnt   = 1;
+
+        for (const auto& cmd : setup.commands)
+        {
+            std::istringstream is(cmd);
+            std::string        token;
+            is >> std::skipws >> token;
+
+            if (token == "go")
+            {
+                std::cerr << "\rThreads " << threads << (split ? ", root split" : "")
+                          << ", position " << cnt++ << '/' << setup.commands.size() / 2
+                          << "      ";
+
+                Search::LimitsType limits = parse_limits(is);
+
+                nodesSearched     = 0;
+                TimePoint elapsed = now();
+
+                engine.go(limits);
+                engine.wait_for_search_finished();
+
+                time += now() - elapsed;
+                nodes += nodesSearched;
+            }
+            else if (token == "position")
+                position(is);
+        }
+
+        return std::make_pair(std::max<TimePoint>(time, 1), nodes);
+    };
+
+    std::stringstream report;
+    report << std::fixed << std::setprecision(2);
+
+    report << "==========================="
+           << "\nFilled invocation          : " << ScalingCommand << " " << setup.filledInvocation
+           << "\nPositions                  : " << setup.commands.size() / 2
+           << "\n\nThreads  Scheduler    Time [ms]  Speedup  Nodes/second  NPS scaling";
+
+    auto [baseTime, baseNodes] = run(1, false);
+    const double baseNps       = 1000.0 * baseNodes / baseTime;
+
+    for (int threads : setup.threads)
+        for (bool split : {false, true})
+        {
+            // With a single thread both schedulers search the same tree
+            if (threads == 1 && split)
+                continue;
+
+            auto [time, nodes] = threads == 1 ? std::make_pair(baseTime, baseNodes)
+                                              : run(threads, split);
+            const double nps   = 1000.0 * nodes / time;
+
+            report << "\n" << std::setw(7) << threads << "  " << std::left << std::setw(10)
+                   << (split ? "root split" : "lazy smp") << std::right << std::setw(12) << time
+                   << std::setw(9) << double(baseTime) / time << std::setw(14) << uint64_t(nps)
+                   << std::setw(13) << nps / baseNps;
+        }
+
+    std::cerr << "\n" << report.str() << std::endl;
+
+    ss = std::istringstream(std::string("name RootSplit value ") + (rootSplit ? "true" : "false"));
+    setoption(ss);
+
+    init_search_update_listeners();
+}
+
+// Measures the throughput of the static evaluation, with each position evaluated on
+// its own and with the positions evaluated in batches, and checks that both agree.
+// The layers are also timed alone, as the refresh of the accumulators of unrelated
+// positions takes most of the time of an evaluation.
+void UCIEngine::eval_speed(std::istream& args) {
+    Benchmark::EvalSpeedSetup setup = Benchmark::setup_eval_speed(args);
+
+    auto [single, singleTime]   = engine.evaluate_positions(setup.fens, setup.rounds, false);
+    auto [batched, batchedTime] = engine.evaluate_positions(setup.fens, setup.rounds, true);
+
+    const uint64_t singleLayers  = engine.time_propagation(setup.fens, setup.rounds, false);
+    const uint64_t batchedLayers = engine.time_propagation(setup.fens, setup.rounds, true);
+
+    const uint64_t evaluations = uint64_t(single.size()) * setup.rounds;
+    const uint64_t propagations =
+      std::max<uint64_t>(uint64_t(setup.fens.size()) * setup.rounds * 2, 1);  // Both networks
+
+    std::cerr << "\n==========================="
+              << "\nFilled invocation          : " << EvalSpeedCommand << " "
+              << setup.filledInvocation                                           //
+              << "\nPositions                  : " << single.size()               //
+              << "\nEvaluations                : " << evaluations                 //
+              << "\nSingle time [ms]           : " << singleTime                  //
+              << "\nSingle positions/second    : "                               //
+              << 1000 * evaluations / std::max<TimePoint>(singleTime, 1)          //
+              << "\nBatched time [ms]          : " << batchedTime                 //
+              << "\nBatched positions/second   : "                               //
+              << 1000 * evaluations / std::max<TimePoint>(batchedTime, 1)         //
+              << "\nResults match              : " << (single == batched ? "yes" : "no")  //
+              << "\nSingle layers [ns/net]     : " << singleLayers / propagations          //
+              << "\nBatched layers [ns/net]    : " << batchedLayers / propagations << std::endl;
+}
+
+// Times the interchangeable kernels of the NNUE layers on the bench positions, and
+// selects the fastest ones for the rest of the session.
+void UCIEngine::tune_kernels(std::istream& args) {
+    Benchmark::EvalSpeedSetup setup = Benchmark::setup_eval_speed(args, 50);
+
+    const auto timings = engine.tune_kernels(setup.fens, setup.rounds);
+    const auto best    = std::min_element(
+      timings.begin(), timings.end(),
+      [](const auto& a, const auto& b) { return a.nanoseconds < b.nanoseconds; });
+
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1);
+
+    ss << "Filled invocation          : " << KernelCommand << " " << setup.filledInvocation
+       << "\nSparse kernel  Dense kernel  Time [us]";
+
+    for (auto it = timings.begin(); it != timings.end(); ++it)
+        ss << "\n" << std::left << std::setw(15)
+           << Eval::NNUE::SparseKernelNames[int(it->kernels.sparse)] << std::setw(14)
+           << Eval::NNUE::DenseKernelNames[int(it->kernels.dense)] << std::right << std::setw(9)
+           << it->nanoseconds / 1000.0 << (it == best ? "  selected" : "");
+
+    sync_cout << ss.str() << sync_endl;
+}
+
+// Times each kind of accumulator update, in isolation, over the moves of the games
+// recorded for the speedtest. Each update is repeated from the same inputs, right
+// away and after evicting the L1 and L2 caches, so that the difference between the
+// warm and the cold times is the cost of the misses. Builds for different SIMD
+// widths can be compared this way.
+void UCIEngine::accumulator_bench(std::istream& args) {
+    static constexpr const char* KindNames[] = {"PSQ incremental", "PSQ refresh",
+                                                "Threat incremental", "Threat rebuild",
+                                                "Row reduce"};
+
+    Benchmark::AccumulatorBenchSetup setup = Benchmark::setup_accumulator_bench(args);
+
+    const auto timings = engine.time_accumulator_updates(setup.games, setup.rounds);
+
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1);
+
+    ss << "\n==========================="
+       << "\nFilled invocation          : " << AccumulatorCommand << " "
+       << setup.filledInvocation                                                      //
+       << "\nSIMD width [bits]          : " << Eval::NNUE::accumulator_simd_width()  //
+       << "\nTimer overhead [ns]        : " << Eval::NNUE::accumulator_timer_overhead()
+       << "\nNetwork  Update                Updates  Rows/update"
+       << "  Replay [ns]  Warm [ns]  Cold [ns]";
+
+    for (int net = 0; net < 2; ++net)
+        for (int kind = 0; kind < Eval::NNUE::UPDATE_KIND_NB; ++kind)
+        {
+            const auto& t = timings[net][kind];
+
+            if (!t.updates)
+                continue;
+
+            const double n = double(t.updates);
+
+            ss << "\n" << std::left << std::setw(9) << (net ? "small" : "big") << std::setw(19)
+               << KindNames[kind] << std::right << std::setw(10) << t.updates << std::setw(13)
+               << t.rows / n << std::setw(13) << t.replayNanoseconds / n << std::setw(11)
+               << t.warmNanoseconds / n << std::setw(11) << t.coldNanoseconds / n;
+        }
+
+    std::cerr << ss.str() << std::endl;
+}
+
+// Reports how often the tablebase probes of all the threads were answered by the
+// probe caches since the last ucinewgame, and what the last premapping run mapped.
+void UCIEngine::tb_cache_stats() {
+    const Tablebases::ProbeCacheStats stats  = engine.get_tb_cache_stats();
+    const Tablebases::PremapStats     premap = engine.get_tb_premap_stats();
+    std::stringstream                 ss;
+    ss << std::fixed << std::setprecision(1);
+
+    auto count = [&](uint64_t hits, uint64_t misses) {
+        ss << hits + misses << "\n    hits                   : " << hits << " ("
+           << (hits + misses ? 100.0 * hits / (hits + misses) : 0.0) << "%)";
+    };
+
+    ss << "WDL probes                 : ";
+    count(stats.wdlHits, stats.wdlMisses);
+    ss << "\nDTZ probes                 : ";
+    count(stats.dtzHits, stats.dtzMisses);
+    ss << "\nPremapped files            : " << premap.files << " (" << (premap.bytes >> 20)
+       << " MB in " << premap.milliseconds << " ms)";
+
+    sync_cout << ss.str() << sync_endl;
+}
+
+// Reports where the evaluations of all the threads spent their time since the last
+// ucinewgame, with an NNUE_PROFILE build.
+void UCIEngine::nnue_profile() {
+#if defined(NNUE_PROFILE)
+    sync_cout << format_nnue_profile(engine.get_nnue_profile()) << sync_endl;
+#else
+    sync_cout << "Layer timings              : not gathered, build with nnueprofile=yes"
+              << sync_endl;
+#endif
+}
+
+// Reports how the accumulators of all the threads were updated since the last
+// ucinewgame, and how many weight rows the updates touched on average, with an
+// NNUE_PROFILE build.
+void UCIEngine::accumulator_stats() {
+#if defined(NNUE_PROFILE)
+    const Eval::NNUE::AccumulatorStats stats = engine.get_accumulator_stats();
+    std::stringstream                  ss;
+    ss << std::fixed << std::setprecision(2);
+
+    auto count = [&](uint64_t n) -> std::stringstream& {
+        ss << n << " (" << (stats.updates ? double(n) / stats.updates : 0.0) << " per update)";
+        return ss;
+    };
+
+    ss << "Updates                    : " << stats.updates;
+    ss << "\nForward incremental        : ";
+    count(stats.forward);
+    ss << "\nBackward incremental       : ";
+    count(stats.backward);
+    ss << "\nFinny table refreshes      : ";
+    count(stats.refreshes);
+    ss << "\nFull threat rebuilds       : ";
+    count(stats.threatRebuilds);
+    ss << "\nRows per update            : "
+       << (stats.updates ? double(stats.rows) / stats.updates : 0.0);
+    ss << "\nRows per Finny refresh     : "
+       << (stats.refreshes ? double(stats.refreshRows) / stats.refreshes : 0.0);
+
+    sync_cout << ss.str() << sync_endl;
+#else
+    sync_cout << "Updates                    : not counted, build with nnueprofile=yes"
+              << sync_endl;
+#endif
+}
+
+// Reports how the transposition table is filled, from a scan of all its entries,
+// and how it has been used since the last ucinewgame, with a TT_STATS build.
+void UCIEngine::tt_stats() {
+    const TTOccupancy occupancy = engine.get_tt_occupancy();
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1);
+
+    auto count = [&](uint64_t n, uint64_t total) -> std::stringstream& {
+        ss << n << " (" << (total ? 100.0 * n / total : 0.0) << "%)";
+        return ss;
+    };
+
+    ss << "Entries used               : ";
+    count(occupancy.used, occupancy.entries) << " of " << occupancy.entries;
+
+#if defined(TT_STATS)
+    const TTStats  stats    = engine.get_tt_stats();
+    const uint64_t replaced = stats.filled + stats.replacedOther + stats.replacedExact
+                            + stats.replacedDepth + stats.replacedAge;
+
+    ss << "\nProbes                     : " << stats.probes;
+    ss << "\n    hits                   : ";
+    count(stats.hits, stats.probes);
+    ss << "\n    collisions             : ";
+    count(stats.collisions, stats.probes);
+    ss << "\nWrites                     : " << stats.writes;
+    ss << "\n    empty entry            : ";
+    count(stats.filled, stats.writes);
+    ss << "\n    evicted position       : ";
+    count(stats.replacedOther, stats.writes);
+    ss << "\n    exact bound            : ";
+    count(stats.replacedExact, stats.writes);
+    ss << "\n    deeper                 : ";
+    count(stats.replacedDepth, stats.writes);
+    ss << "\n    older entry            : ";
+    count(stats.replacedAge, stats.writes);
+    ss << "\n    kept                   : ";
+    count(stats.writes - replaced, stats.writes);
+#else
+    ss << "\nProbes and writes          : not counted, build with ttstats=yes";
+#endif
+
+    ss << "\nEntries by depth";
+    for (size_t d = 0; d < occupancy.depth.size(); ++d)
+        if (occupancy.depth[d])
+        {
+            ss << "\n    " << std::setw(3) << int(d) + DEPTH_ENTRY_OFFSET
+               << "                    : ";
+            count(occupancy.depth[d], occupancy.used);
+        }
+
+    ss << "\nEntries by age";
+    for (size_t a = 0; a < occupancy.age.size(); ++a)
+        if (occupancy.age[a])
+        {
+            ss << "\n    " << std::setw(3) << a << "                    : ";
+            count(occupancy.age[a], occupancy.used);
+        }
+
+    sync_cout << ss.str() << sync_endl;
+}
+
+// Analyses many positions with the whole thread pool, one position per thread at a time.
+// FENs are read from the given file, or else from the following input lines up to "end",
+// and each result is printed as one line of JSON as soon as its search completes. Lines
+// that are not a valid position are skipped. Returns whether a quit ended the input.
+bool UCIEngine::batch(std::istringstream& is) {
+    std::string token, file, limitArgs;
+
+    while (is >> token)
+        if (token == "file")
+            is >> file;
+        else
+            limitArgs += token + " ";
+
+    std::istringstream limitStream(limitArgs);
+    Search::LimitsType limits = parse_limits(limitStream);
+
+    std::ifstream fenFile;
+    if (!file.empty())
+    {
+        fenFile.open(file);
+        if (!fenFile)
+        {
+            sync_cout << "info string Failed to open " << file << sync_endl;
+            return false;
+        }
+    }
+
+    std::istream& in   = file.empty() ? std::cin : fenFile;
+    bool          quit = false;
+
+    // Reads the next position, skipping blank lines and invalid FENs. On the UCI input
+    // a stop or quit ends the positions as well, and stops the searches in progress.
+    auto read = [&](std::string& fen) {
+        while (std::getline(in, fen))
+        {
+            std::istringstream line(fen);
+            std::string        first;
+            line >> first;
+
+            if (first == "end")
+                return false;
+
+            if (file.empty() && (first == "stop" || first == "quit"))
+            {
+                quit = first == "quit";
+                engine.stop();
+                return false;
+            }
+
+            if (first.empty())
+                continue;
+
+            if (Position::is_valid_fen(fen))
+                return true;
+
+            sync_cout << "info string Skipping invalid FEN " << fen << sync_endl;
+        }
+        return false;
+    };
+
+    // Without a fixed limit the searches would never end, so consume the input and bail out
+    if (!limits.depth && !limits.nodes)
+    {
+        std::string fen;
+        while (read(fen))
+        {}
+
+        sync_cout << "info string batch requires a depth or nodes limit" << sync_endl;
+        return quit;
+    }
+
+    if (!file.empty())
+    {
+        engine.batch(read, limits, on_batch_result);
+        return false;
+    }
+
+    // The positions on the UCI input are read on this thread while the batch runs on
+    // another, so that a stop is seen while a search is in progress.
+    std::mutex              mutex;
+    std::condition_variable cv;
+    std::deque<std::string> fens;
+    bool                    closed = false;
+
+    auto next = [&](std::string& fen) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] { return closed || !fens.empty(); });
+
+        if (fens.empty())
+            return false;
+
+        fen = std::move(fens.front());
+        fens.pop_front();
+        return true;
+    };
+
+    std::thread batchThread([&]() { engine.batch(next, limits, on_batch_result); });
+
+    for (std::string fen; read(fen);)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fens.push_back(std::move(fen));
+        cv.notify_one();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+    }
+    cv.notify_all();
+
+    batchThread.join();
+    return quit;
+}
+
 void UCIEngine::setoption(std::istringstream& is) {
     engine.wait_for_search_finished();
     engine.get_options().setoption(is);
@@ -640,6 +1318,42 @@ void UCIEngine::on_update_full(const Engine::InfoFull& info, bool showWDL) {
     sync_cout << ss.str() << sync_endl;
 }
 
+void UCIEngine::on_batch_result(const Search::BatchResult& result) {
+    sync_cout << "{\"id\":" << result.id << ",\"fen\":" << json_string(result.fen) << ","
+              << json_info(result.info) << ",\"bestmove\":" << json_string(result.bestmove) << "}"
+              << sync_endl;
+}
+
+// With the "InfoFormat" option set to json, the search updates are printed as JSON lines
+// instead, one object per line, with a "type" field telling them apart. The fields are
+// named as the UCI tokens, scores are objects and the PV and WDL are arrays.
+void UCIEngine::on_update_no_moves_json(const Engine::InfoShort& info) {
+    sync_cout << "{\"type\":\"info\",\"depth\":" << info.depth
+              << ",\"score\":" << json_score(info.score) << "}" << sync_endl;
+}
+
+void UCIEngine::on_update_full_json(const Engine::InfoFull& info) {
+    sync_cout << "{\"type\":\"info\"," << json_info(info) << "}" << sync_endl;
+}
+
+void UCIEngine::on_iter_json(const Engine::InfoIter& info) {
+    sync_cout << "{\"type\":\"currmove\",\"depth\":" << info.depth
+              << ",\"currmove\":" << json_string(info.currmove)
+              << ",\"currmovenumber\":" << info.currmovenumber << "}" << sync_endl;
+}
+
+void UCIEngine::on_bestmove_json(std::string_view bestmove, std::string_view ponder) {
+    sync_cout << "{\"type\":\"bestmove\",\"bestmove\":" << json_string(bestmove);
+    if (!ponder.empty())
+        std::cout << ",\"ponder\":" << json_string(ponder);
+    std::cout << "}" << sync_endl;
+}
+
+void UCIEngine::on_root_probe_json(const Engine::InfoRootProbe& info) {
+    sync_cout << "{\"type\":\"tbprobe\",\"moves\":" << info.moves
+              << ",\"time\":" << info.timeMs << "}" << sync_endl;
+}
+
 void UCIEngine::on_iter(const Engine::InfoIter& info) {
     std::stringstream ss;
 
@@ -658,4 +1372,9 @@ void UCIEngine::on_bestmove(std::string_view bestmove, std::string_view ponder)
     std::cout << sync_endl;
 }
 
+void UCIEngine::on_root_probe(const Engine::InfoRootProbe& info) {
+    sync_cout << "info string Probed " << info.moves << " root moves in " << info.timeMs << " ms"
+              << sync_endl;
+}
+
 }  // namespace Stockfish
@@ -63,6 +63,15 @@ class UCIEngine {
     void          go(std::istringstream& is);
     void          bench(std::istream& args);
     void          benchmark(std::istream& args);
+    void          scaling(std::istream& args);
+    void          eval_speed(std::istream& args);
+    void          tune_kernels(std::istream& args);
+    void          accumulator_bench(std::istream& args);
+    void          tt_stats();
+    void          accumulator_stats();
+    void          nnue_profile();
+    void          tb_cache_stats();
+    bool          batch(std::istringstream& is);
     void          position(std::istringstream& is);
     void          setoption(std::istringstream& is);
     std::uint64_t perft(const Search::LimitsType&);
@@ -71,6 +80,14 @@ class UCIEngine {
     static void on_update_full(const Engine::InfoFull& info, bool showWDL);
     static void on_iter(const Engine::InfoIter& info);
     static void on_bestmove(std::string_view bestmove, std::string_view ponder);
+    static void on_root_probe(const Engine::InfoRootProbe& info);
+    static void on_batch_result(const Search::BatchResult& result);
+
+    static void on_update_no_moves_json(const Engine::InfoShort& info);
+    static void on_update_full_json(const Engine::InfoFull& info);
+    static void on_iter_json(const Engine::InfoIter& info);
+    static void on_bestmove_json(std::string_view bestmove, std::string_view ponder);
+    static void on_root_probe_json(const Engine::InfoRootProbe& info);
 
     void init_search_update_listeners();
 };
@@ -1,4 +1,5 @@
 import argparse
+import json
 import re
 import sys
 import subprocess
@@ -147,6 +148,31 @@ class TestCLI(metaclass=OrderedClassMembers):
         )
         assert self.stockfish.process.returncode == 0
 
+    def test_bench_tt_check(self):
+        compiler = Stockfish("compiler".split(" "), True)
+        self.stockfish = Stockfish("bench 16 1 8".split(" "), True)
+        assert self.stockfish.process.returncode == 0
+
+        # Only builds with ttcheck=yes check the entries and report the rejected ones
+        checked = "TT_CHECK_ENTRIES" in compiler.process.stdout
+        assert ("TT rejected" in self.stockfish.process.stderr) == checked
+
+    def test_scalingtest_2_threads_depth_5(self):
+        self.stockfish = Stockfish("scalingtest 2 5 16".split(" "), True)
+        assert self.stockfish.process.returncode == 0
+
+    def test_evalspeedtest_10_rounds(self):
+        self.stockfish = Stockfish("evalspeedtest 10".split(" "), True)
+        assert self.stockfish.process.returncode == 0
+
+    def test_kerneltune_5_rounds(self):
+        self.stockfish = Stockfish("kerneltune 5".split(" "), True)
+        assert self.stockfish.process.returncode == 0
+
+    def test_accumulatorbench_1_round(self):
+        self.stockfish = Stockfish("accumulatorbench 1".split(" "), True)
+        assert self.stockfish.process.returncode == 0
+
     def test_d(self):
         self.stockfish = Stockfish("d".split(" "), True)
         assert self.stockfish.process.returncode == 0
@@ -411,6 +437,274 @@ class TestInteractive(metaclass=OrderedClassMembers):
 
         self.stockfish.send_command("setoption name Skill Level value 20")
 
+    def test_export_import_tt(self):
+        current_path = os.path.abspath(os.getcwd())
+        tt_file = os.path.join(current_path, "verify.tt")
+
+        self.stockfish.send_command("position startpos")
+        self.stockfish.send_command("go depth 8")
+        self.stockfish.starts_with("bestmove")
+
+        self.stockfish.send_command(f"export_tt {tt_file}")
+        self.stockfish.starts_with("Transposition table saved successfully")
+
+        self.stockfish.send_command("ucinewgame")
+        self.stockfish.send_command(f"import_tt {tt_file}")
+        self.stockfish.starts_with("Transposition table loaded successfully")
+
+        self.stockfish.send_command("setoption name Hash value 2")
+        self.stockfish.send_command(f"import_tt {tt_file}")
+        self.stockfish.starts_with("Failed to import the transposition table")
+
+        self.stockfish.send_command("setoption name Hash value 16")
+        os.remove(tt_file)
+
+    def test_shared_hash(self):
+        self.stockfish.send_command(f"setoption name SharedHash value verify_{os.getpid()}")
+        self.stockfish.send_command("ucinewgame")
+        self.stockfish.send_command("position startpos")
+        self.stockfish.send_command("go depth 8")
+        self.stockfish.starts_with("bestmove")
+
+        self.stockfish.send_command("setoption name SharedHash value <empty>")
+        self.stockfish.send_command("go depth 8")
+        self.stockfish.starts_with("bestmove")
+
+    def test_hash_resize_keeps_table(self):
+        self.stockfish.send_command("setoption name Hash value 32")
+        self.stockfish.send_command("ucinewgame")
+        self.stockfish.send_command("position startpos")
+        self.stockfish.send_command("go depth 8")
+        self.stockfish.starts_with("bestmove")
+
+        # Halving the size keeps the most valuable entries, setting the same size
+        # clears the table as before.
+        def callback(output):
+            if output.startswith("Entries used"):
+                assert not output.startswith("Entries used               : 0 ")
+                return True
+
+            return False
+
+        self.stockfish.send_command("setoption name Hash value 16")
+        self.stockfish.send_command("tt_stats")
+        self.stockfish.check_output(callback)
+
+        self.stockfish.send_command("setoption name Hash value 16")
+        self.stockfish.send_command("tt_stats")
+        self.stockfish.starts_with("Entries used               : 0 ")
+
+    def test_export_net_compressed(self):
+        current_path = os.path.abspath(os.getcwd())
+        big = os.path.join(current_path, "verify_big_compressed.nnue")
+        small = os.path.join(current_path, "verify_small_compressed.nnue")
+        default = None
+
+        def callback(output):
+            nonlocal default
+            if output.startswith("option name EvalFile type string default"):
+                default = output.split(" ")[-1]
+            return output == "uciok"
+
+        self.stockfish.send_command("uci")
+        self.stockfish.check_output(callback)
+
+        self.stockfish.send_command(f"export_net_compressed {big} {small}")
+        self.stockfish.equals(f"Network saved successfully to {big}")
+        self.stockfish.equals(f"Network saved successfully to {small}")
+
+        self.stockfish.send_command(f"setoption name EvalFile value {big}")
+        self.stockfish.send_command("go depth 5")
+        self.stockfish.contains(f"NNUE evaluation using {big}")
+        self.stockfish.starts_with("bestmove")
+
+        # bench searches again with one row per threat feature, for the same nodes
+        nodes = None
+
+        def bench_callback(output):
+            nonlocal nodes
+            if output.startswith("Nodes searched  : "):
+                nodes = output.split(" ")[-1]
+            return output.startswith("Regular rows    : ")
+
+        self.stockfish.send_command("bench 16 1 4")
+        self.stockfish.check_output(bench_callback)
+        assert self.stockfish.get_output()[-1].endswith(f" {nodes} nodes searched")
+
+        self.stockfish.send_command(f"setoption name EvalFile value {default}")
+
+        os.remove(big)
+        os.remove(small)
+
+    def test_tt_stats(self):
+        self.stockfish.send_command("ucinewgame")
+        self.stockfish.send_command("position startpos")
+        self.stockfish.send_command("go depth 8")
+        self.stockfish.starts_with("bestmove")
+
+        self.stockfish.send_command("tt_stats")
+        self.stockfish.starts_with("Entries used")
+        self.stockfish.contains("Entries by age")
+
+    def test_accumulator_stats(self):
+        self.stockfish.send_command("position startpos")
+        self.stockfish.send_command("go depth 8")
+        self.stockfish.starts_with("bestmove")
+
+        # Only builds with nnueprofile=yes count the updates
+        counted = False
+
+        def callback(output):
+            nonlocal counted
+            counted = "not counted" not in output
+            return output.startswith("Updates")
+
+        self.stockfish.send_command("accumulator_stats")
+        self.stockfish.check_output(callback)
+
+        if counted:
+            self.stockfish.starts_with("Forward incremental")
+            self.stockfish.starts_with("Backward incremental")
+            self.stockfish.starts_with("Finny table refreshes")
+            self.stockfish.starts_with("Full threat rebuilds")
+            self.stockfish.starts_with("Rows per update")
+            self.stockfish.starts_with("Rows per Finny refresh")
+
+    def test_nnue_profile(self):
+        self.stockfish.send_command("position startpos")
+        self.stockfish.send_command("go depth 6")
+        self.stockfish.starts_with("bestmove")
+
+        self.stockfish.send_command("nnue_profile")
+        self.stockfish.starts_with("Layer timings")
+
+    def test_tb_cache_stats(self):
+        self.stockfish.send_command("setoption name SyzygyProbeCache value 1")
+        self.stockfish.send_command("tb_cache_stats")
+        self.stockfish.starts_with("WDL probes")
+        self.stockfish.starts_with("hits")
+        self.stockfish.starts_with("DTZ probes")
+        self.stockfish.send_command("setoption name SyzygyProbeCache value 0")
+
+    def test_syzygy_index_file(self):
+        current_path = os.path.abspath(os.getcwd())
+        tb_dir = os.path.join(current_path, "verify_tb")
+        index_file = os.path.join(current_path, "verify_tb.idx")
+
+        os.makedirs(tb_dir, exist_ok=True)
+        with open(os.path.join(tb_dir, "KRvK.rtbw"), "wb") as f:
+            f.write(bytes(80))
+
+        self.stockfish.send_command(f"setoption name SyzygyIndexFile value {index_file}")
+        self.stockfish.send_command(f"setoption name SyzygyPath value {tb_dir}")
+        self.stockfish.expect(
+            "info string Found 1 WDL and 0 DTZ tablebase files (up to 3-man)."
+        )
+
+        self.stockfish.send_command(f"setoption name SyzygyPath value {tb_dir}")
+        self.stockfish.expect(f"info string Loaded tablebase index file {index_file}")
+        self.stockfish.expect(
+            "info string Found 1 WDL and 0 DTZ tablebase files (up to 3-man)."
+        )
+
+        # Same size and directory, but a header that does not match the stamp
+        with open(os.path.join(tb_dir, "KRvK.rtbw"), "wb") as f:
+            f.write(bytes([0x71, 0xE8, 0x23, 0x5D]) + bytes(76))
+
+        self.stockfish.send_command("position fen 8/8/8/8/8/2k5/8/R3K3 w - - 0 1")
+        self.stockfish.send_command("go depth 1")
+        self.stockfish.expect("bestmove *")
+
+        def callback(output):
+            assert not output.startswith("info string Loaded tablebase index file")
+            return output == "info string Found 1 WDL and 0 DTZ tablebase files (up to 3-man)."
+
+        self.stockfish.send_command(f"setoption name SyzygyPath value {tb_dir}")
+        self.stockfish.check_output(callback)
+
+        self.stockfish.send_command(f"setoption name SyzygyPath value {tb_dir}")
+        self.stockfish.expect(f"info string Loaded tablebase index file {index_file}")
+
+        self.stockfish.send_command("setoption name SyzygyPath value <empty>")
+        self.stockfish.send_command("setoption name SyzygyIndexFile value <empty>")
+        os.remove(os.path.join(tb_dir, "KRvK.rtbw"))
+        os.rmdir(tb_dir)
+        os.remove(index_file)
+
+    def test_warm_finny_tables(self):
+        self.stockfish.send_command("setoption name WarmFinnyTables value true")
+        self.stockfish.send_command("position startpos moves e2e4 e7e5")
+        self.stockfish.send_command("go depth 6")
+        self.stockfish.starts_with("bestmove")
+
+        self.stockfish.send_command("ucinewgame")
+        self.stockfish.send_command("setoption name Threads value 2")
+        self.stockfish.send_command("position startpos moves e2e4 e7e5 g1f3")
+        self.stockfish.send_command("go depth 6")
+        self.stockfish.starts_with("bestmove")
+
+        self.stockfish.send_command("setoption name Threads value 1")
+        self.stockfish.send_command("setoption name WarmFinnyTables value false")
+
+    def test_batch(self):
+        current_path = os.path.abspath(os.getcwd())
+        fen_file = os.path.join(current_path, "batch.fen")
+
+        with open(fen_file, "w") as f:
+            f.write("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1\n")
+            f.write("5rk1/1K4B1/8/8/8/8/8/8 w - - 0 1\n")
+
+        results = {}
+
+        def callback(output):
+            if output.startswith("{"):
+                result = json.loads(output)
+                results[result["id"]] = result
+            return len(results) == 2
+
+        self.stockfish.send_command(f"batch depth 5 file {fen_file}")
+        self.stockfish.check_output(callback)
+
+        assert results[0]["depth"] == 5 and len(results[0]["pv"]) > 0
+        assert results[1]["fen"] == "5rk1/1K4B1/8/8/8/8/8/8 w - - 0 1"
+
+        self.stockfish.send_command("batch nodes 1000")
+        self.stockfish.send_command("8/8/8/8/8/5k2/8/4K2q w - - 0 1")
+        self.stockfish.send_command("end")
+        self.stockfish.expect('{"id":0,*"bestmove":"e1d2"*}')
+
+        # Invalid positions are skipped, and a stop ends the input
+        self.stockfish.send_command("batch nodes 1000")
+        self.stockfish.send_command("8/8/8/8/8/8/8/8 w - - 0 1")
+        self.stockfish.expect("info string Skipping invalid FEN 8/8/8/8/8/8/8/8 w - - 0 1")
+        self.stockfish.send_command("stop")
+        self.stockfish.send_command("isready")
+        self.stockfish.equals("readyok")
+
+        os.remove(fen_file)
+
+    def test_info_format_json(self):
+        self.stockfish.send_command("setoption name InfoFormat value json")
+        self.stockfish.send_command("setoption name MultiPV value 2")
+        self.stockfish.send_command("position startpos")
+        self.stockfish.send_command("go depth 5")
+
+        records = []
+
+        def callback(output):
+            if output.startswith("{"):
+                records.append(json.loads(output))
+            return len(records) > 0 and records[-1]["type"] == "bestmove"
+
+        self.stockfish.check_output(callback)
+
+        infos = [r for r in records if r["type"] == "info"]
+        assert infos[-1]["depth"] == 5 and infos[-1]["multipv"] == 2
+        assert len(infos[-1]["pv"]) > 0 and "cp" in infos[-1]["score"]
+
+        self.stockfish.send_command("setoption name MultiPV value 1")
+        self.stockfish.send_command("setoption name InfoFormat value text")
+
 
 class TestSyzygy(metaclass=OrderedClassMembers):
     def beforeAll(self):
@@ -437,6 +731,7 @@ class TestSyzygy(metaclass=OrderedClassMembers):
     def test_syzygy_bench(self):
         self.stockfish.send_command("bench 128 1 8 default depth")
         self.stockfish.expect("Nodes searched  :*")
+        self.stockfish.expect("TB wait (ms)    : *")
 
     def test_syzygy_position(self):
         self.stockfish.send_command("ucinewgame")
@@ -474,6 +769,68 @@ class TestSyzygy(metaclass=OrderedClassMembers):
         self.stockfish.check_output(check_output)
         self.stockfish.expect("bestmove *")
 
+    def test_syzygy_probe_cache(self):
+        self.stockfish.send_command("setoption name SyzygyProbeCache value 16")
+        self.stockfish.send_command("ucinewgame")
+        self.stockfish.send_command("position fen 8/1P6/2B5/8/4K3/8/6k1/8 w - - 0 1")
+        self.stockfish.send_command("go depth 8")
+        self.stockfish.expect("bestmove *")
+
+        self.stockfish.send_command("tb_cache_stats")
+        self.stockfish.starts_with("WDL probes")
+        self.stockfish.starts_with("hits")
+        self.stockfish.starts_with("DTZ probes")
+
+        self.stockfish.send_command("setoption name SyzygyProbeCache value 0")
+
+    def test_syzygy_premap(self):
+        self.stockfish.send_command("setoption name SyzygyWillNeed value true")
+        self.stockfish.send_command("setoption name SyzygyPremap value all")
+        self.stockfish.send_command("tb_cache_stats")
+        self.stockfish.expect("Premapped files            : * (* MB in * ms)")
+
+        self.stockfish.send_command("setoption name SyzygyPremap value none")
+        self.stockfish.send_command("setoption name SyzygyWillNeed value false")
+
+    def test_syzygy_index_file(self):
+        index_file = os.path.join(os.path.abspath(os.getcwd()), "verify_syzygy.idx")
+        syzygy_path = os.path.join(PATH, "syzygy")
+
+        self.stockfish.send_command(f"setoption name SyzygyIndexFile value {index_file}")
+        self.stockfish.expect(
+            "info string Found 35 WDL and 35 DTZ tablebase files (up to 4-man)."
+        )
+
+        self.stockfish.send_command(f"setoption name SyzygyPath value {syzygy_path}")
+        self.stockfish.expect(f"info string Loaded tablebase index file {index_file}")
+        self.stockfish.expect(
+            "info string Found 35 WDL and 35 DTZ tablebase files (up to 4-man)."
+        )
+
+        self.stockfish.send_command("ucinewgame")
+        self.stockfish.send_command("position fen 8/1P6/2B5/8/4K3/8/6k1/8 w - - 0 1")
+        self.stockfish.send_command("go depth 5")
+        self.stockfish.expect("bestmove *")
+
+        self.stockfish.send_command("setoption name SyzygyIndexFile value <empty>")
+        os.remove(index_file)
+
+    def test_syzygy_parallel_root_probe(self):
+        self.stockfish.send_command("setoption name Threads value 4")
+        self.stockfish.send_command("ucinewgame")
+        self.stockfish.send_command("position fen 8/1P6/2B5/8/4K3/8/6k1/8 w - - 0 1")
+        self.stockfish.send_command("go depth 5")
+        self.stockfish.expect("info string Probed * root moves in * ms")
+        self.stockfish.expect("bestmove *")
+
+        self.stockfish.send_command("setoption name InfoFormat value json")
+        self.stockfish.send_command("go depth 5")
+        self.stockfish.starts_with('{"type":"tbprobe","moves":')
+        self.stockfish.starts_with('{"type":"bestmove",')
+        self.stockfish.send_command("setoption name InfoFormat value text")
+
+        self.stockfish.send_command("setoption name Threads value 1")
+
 
 def parse_args():
     parser = argparse.ArgumentParser(description="Run Stockfish with testing options")